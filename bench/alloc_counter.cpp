@@ -0,0 +1,58 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<uint64_t> frees{0};
+static std::atomic<uint64_t> bytes{0};
+
+namespace alloc_counter
+{
+    Snapshot snapshot()
+    {
+        return {allocations.load(std::memory_order_relaxed), frees.load(std::memory_order_relaxed),
+                bytes.load(std::memory_order_relaxed)};
+    }
+}
+
+static void *counted_alloc(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+static void counted_free(void *p)
+{
+    if (p == nullptr)
+        return;
+    frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+void *operator new(std::size_t size) { return counted_alloc(size); }
+void *operator new[](std::size_t size) { return counted_alloc(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return counted_alloc(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { counted_free(p); }
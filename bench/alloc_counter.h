@@ -0,0 +1,26 @@
+// Counts heap allocations made through the global operator new. Linking
+// alloc_counter.cpp into an executable replaces the global allocation
+// functions for the whole program.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc_counter
+{
+    struct Snapshot
+    {
+        uint64_t allocations;
+        uint64_t frees;
+        uint64_t bytes;
+    };
+
+    // totals since program start
+    Snapshot snapshot();
+
+    // difference between two snapshots
+    inline Snapshot operator-(const Snapshot &a, const Snapshot &b)
+    {
+        return {a.allocations - b.allocations, a.frees - b.frees, a.bytes - b.bytes};
+    }
+}
@@ -0,0 +1,71 @@
+// Timing and JSON reporting shared by the host benchmarks. Link
+// alloc_counter.cpp to get allocation figures.
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+
+namespace bench
+{
+    struct Result
+    {
+        std::string name;
+        int size;
+        double ns_per_op;
+        double allocs_per_op;
+        double bytes_per_op;
+        long iterations;
+    };
+
+    // keeps the optimiser from discarding benchmarked work
+    template <typename T>
+    inline void do_not_optimize(T const &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Runs op repeatedly for at least min_ms and reports the mean cost of one call.
+    // op is run once before measuring so lazily built state is not counted.
+    template <typename F>
+    Result measure(const std::string &name, int size, F &&op, double min_ms = 20.0)
+    {
+        using Clock = std::chrono::steady_clock;
+        op();
+
+        long iterations = 1;
+        while (true)
+        {
+            auto allocs_before = alloc_counter::snapshot();
+            auto start = Clock::now();
+            for (long i = 0; i < iterations; i++)
+                op();
+            std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+            auto allocs = alloc_counter::snapshot() - allocs_before;
+
+            if (elapsed.count() >= min_ms || iterations >= (1L << 30))
+                return {name, size, elapsed.count() * 1e6 / iterations, double(allocs.allocations) / iterations,
+                        double(allocs.bytes) / iterations, iterations};
+            iterations *= elapsed.count() > 0 ? std::max(2.0, min_ms / elapsed.count() * 1.2) : 10;
+        }
+    }
+
+    // Prints results as {"benchmark": ..., "results": [...]}.
+    inline void write_json(FILE *out, const char *benchmark, const std::vector<Result> &results)
+    {
+        fprintf(out, "{\n  \"benchmark\": \"%s\",\n  \"results\": [\n", benchmark);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &r = results[i];
+            fprintf(out,
+                    "    {\"name\": \"%s\", \"size\": %d, \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, "
+                    "\"bytes_per_op\": %.1f, \"iterations\": %ld}%s\n",
+                    r.name.c_str(), r.size, r.ns_per_op, r.allocs_per_op, r.bytes_per_op, r.iterations,
+                    i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+}
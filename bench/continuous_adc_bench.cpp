@@ -0,0 +1,100 @@
+// Runs Esp32ContinuousAdc against the adc_digi stand-in of the host build:
+// checks that read() never waits and returns only the newest samples, the
+// decimation, the counting of ring overflows and a pH probe reading through
+// it. Exits with 1 when a check fails. The cost of a read is not reported, on
+// the host it is dominated by the stand-in producing the conversions.
+//
+//   continuous_adc_bench
+#include <cmath>
+#include <cstdio>
+
+#include "esp32_continuous_adc.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "gravity_ph.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    failures += !ok;
+}
+
+// runs the main loop every 16 ms for ms
+static void run_loop(uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += 16)
+    {
+        esphome::host::advance(16);
+        esphome::App.loop();
+    }
+}
+
+int main()
+{
+    float level = 1.0f;
+    esphome::host::set_adc_digi_signal([&level]()
+                                       { return level; });
+
+    // 20 kHz decimated by 100: 200 samples per second
+    Esp32ContinuousAdc adc(ADC1_CHANNEL_6);
+    esphome::App.register_component(&adc);
+    esphome::App.setup();
+    check(!adc.is_failed() && adc.sample_rate() == 200, "setup starts the conversions at 200 samples/s");
+
+    float samples[CONTINUOUS_ADC_SAMPLES];
+    run_loop(200);
+    const uint32_t before = esphome::millis();
+    size_t n = adc.read(samples, 16);
+    bool near = n == 16;
+    for (size_t i = 0; i < n; i++)
+        near = near && std::fabs(samples[i] - 1.0f) < 0.001f;
+    check(near, "a read returns the requested samples at the signal level");
+    check(esphome::millis() == before, "a read does not wait for the DMA");
+    check(adc.read(samples, 16) == 0, "a second read right away has no new samples");
+
+    // a rising signal: the newest samples come back, oldest first
+    uint32_t conversion = 0;
+    esphome::host::set_adc_digi_signal([&conversion]()
+                                       { return 1.0f + 0.001f * (conversion++ / 100); });
+    run_loop(480);
+    n = adc.read(samples, 16);
+    bool rising = n == 16;
+    for (size_t i = 1; i < n; i++)
+        rising = rising && samples[i] > samples[i - 1];
+    const float newest = 1.0f + 0.001f * (conversion / 100 - 1);
+    check(rising && std::fabs(samples[n - 1] - newest) < 0.0015f, "a read returns the newest samples, oldest first");
+
+    // conversions alternate around 1.5 V, every sample is their average
+    esphome::host::set_adc_digi_signal([&conversion]()
+                                       { return conversion++ % 2 ? 1.45f : 1.55f; });
+    run_loop(200);
+    n = adc.read(samples, 16);
+    near = n == 16;
+    for (size_t i = 0; i < n; i++)
+        near = near && std::fabs(samples[i] - 1.5f) < 0.001f;
+    check(near, "decimation averages the raw conversions");
+
+    // the loop stalls for half a second, longer than the ring holds
+    esphome::host::advance(500);
+    esphome::App.loop();
+    check(adc.overflows() == 1 && esphome::host::adc_digi_dropped() > 0, "a stalled loop is counted as an overflow");
+    run_loop(200);
+    check(adc.read(samples, 16) == 16 && adc.overflows() == 1, "sampling goes on after an overflow");
+
+    // a pH probe at the factory neutral voltage, a 16 sample median per reading
+    level = (float)PH_7_DEFAULT_VOLTAGE;
+    esphome::host::set_adc_digi_signal([&level]()
+                                       { return level; });
+    esphome::adc::ADCSensor unused;
+    GravityPhSensor ph(&unused);
+    ph.set_sample_source(&adc);
+    ph.set_oversampling(16, SampleReduction::MEDIAN);
+    auto ph_sensors = ph.sensors();
+    ph.call_setup();
+    run_loop(16000);
+    check(std::fabs(ph_sensors[0]->state - 7.0f) < 0.01f, "a pH probe reads through the continuous source");
+
+    return failures == 0 ? 0 : 1;
+}
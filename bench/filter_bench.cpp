@@ -0,0 +1,203 @@
+// Benchmarks LevelTrendFilter on the host: the cost of one predict/update
+// step, alone and inside the pH and TDS sensors, and how fast it follows a
+// dosing change compared to the sliding window averages it replaces.
+// Results are written as JSON to stdout, or to the file given as argument.
+//
+//   filter_bench [output.json]
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "gravity_ph.h"
+#include "gravity_tds.h"
+#include "level_trend_filter.h"
+#include "sample_source.h"
+
+// readings every 15 s; pH 7.0 for an hour, then a dose lifts it to 7.3 over
+// 10 minutes, followed by another hour at 7.3
+static const uint32_t READING_INTERVAL = 15000;
+static const int DOSE_START = 240;
+static const int DOSE_READINGS = 40;
+static const int READINGS = DOSE_START + DOSE_READINGS + 240;
+static const float PH_BEFORE = 7.0f;
+static const float PH_AFTER = 7.3f;
+static const float READING_NOISE = 0.02f;
+
+static float true_ph(int i)
+{
+    if (i < DOSE_START)
+        return PH_BEFORE;
+    if (i >= DOSE_START + DOSE_READINGS)
+        return PH_AFTER;
+    return PH_BEFORE + (PH_AFTER - PH_BEFORE) * (i - DOSE_START) / DOSE_READINGS;
+}
+
+// reproducible normal noise: the sum of 12 uniforms
+static float gaussian(uint32_t &state)
+{
+    float sum = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        sum += (state >> 8) / 16777216.0f;
+    }
+    return sum - 6;
+}
+
+struct Response
+{
+    const char *name;
+    // standard deviation around the true pH during the first hour
+    double noise;
+    // seconds from the start of the dose until 90 % of the change shows
+    double t90;
+    // furthest excursion past the final pH
+    double overshoot;
+};
+
+template <typename F>
+static Response respond(const char *name, const std::vector<float> &readings, F &&filter)
+{
+    Response r = {name, 0, NAN, 0};
+    double squares = 0;
+    int settled = 0;
+    for (int i = 0; i < READINGS; i++)
+    {
+        const float out = filter(readings[i], i * READING_INTERVAL);
+        // the windows need 10 minutes to fill
+        if (i >= 40 && i < DOSE_START)
+        {
+            squares += (out - PH_BEFORE) * (out - PH_BEFORE);
+            settled++;
+        }
+        if (i >= DOSE_START && std::isnan(r.t90) && out >= PH_BEFORE + 0.9f * (PH_AFTER - PH_BEFORE))
+            r.t90 = (i - DOSE_START) * READING_INTERVAL / 1000.0;
+        if (i >= DOSE_START)
+            r.overshoot = std::fmax(r.overshoot, out - PH_AFTER);
+    }
+    r.noise = std::sqrt(squares / settled);
+    return r;
+}
+
+static Response moving_average(const char *name, const std::vector<float> &readings, size_t window)
+{
+    std::vector<float> history;
+    return respond(name, readings, [&](float value, uint32_t)
+                   {
+        history.push_back(value);
+        const size_t n = history.size() < window ? history.size() : window;
+        float sum = 0;
+        for (size_t i = history.size() - n; i < history.size(); i++)
+            sum += history[i];
+        return sum / n; });
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<bench::Result> results;
+
+    // the filter alone, 15 s apart
+    LevelTrendFilter filter;
+    filter.configure(0.0001f, 0.000005f, 0.005f);
+    uint32_t now = 0;
+    uint32_t noise = 1;
+    filter.step(7.0f, NAN, now);
+    results.push_back(bench::measure("predict", 2, [&]()
+                                     { filter.predict(15);
+                                       bench::do_not_optimize(filter.level()); }));
+    filter.reset();
+    filter.step(7.0f, NAN, now);
+    results.push_back(bench::measure("update", 2, [&]()
+                                     { bench::do_not_optimize(filter.update(7.0f + 0.02f * gaussian(noise), 0.0004f)); }));
+    filter.reset();
+    results.push_back(bench::measure("step", 2, [&]()
+                                     { now += READING_INTERVAL;
+                                       bench::do_not_optimize(filter.step(7.0f + 0.02f * gaussian(noise), 0.0004f, now)); }));
+
+    // the sensors on 16 sample bursts of a simulated probe, without and with smoothing
+    esphome::adc::ADCSensor ph_voltage;
+    esphome::adc::ADCSensor tds_voltage;
+    esphome::sensor::Sensor temperature;
+    temperature.publish_state(25.0f);
+    SimulatedSampleSource ph_probe(1.442f, 1000);
+    ph_probe.set_noise(0.005f);
+    SimulatedSampleSource tds_probe(0.45f, 1000);
+    tds_probe.set_noise(0.005f);
+    GravityPhSensor ph(&ph_voltage);
+    GravityTdsSensor tds(&tds_voltage, &temperature);
+    ph.set_sample_source(&ph_probe);
+    ph.set_oversampling(16, SampleReduction::MEDIAN);
+    tds.set_sample_source(&tds_probe);
+    tds.set_oversampling(16, SampleReduction::TRIMMED_MEAN, 0.25f);
+    auto ph_sensors = ph.sensors();
+    auto tds_sensors = tds.sensors();
+    esphome::App.setup();
+
+    results.push_back(bench::measure("ph_update", 16, [&]()
+                                     { esphome::host::advance(READING_INTERVAL);
+                                       ph.update();
+                                       bench::do_not_optimize(ph_sensors[0]->state); }));
+    ph.set_smoothing();
+    results.push_back(bench::measure("ph_update_smoothed", 16, [&]()
+                                     { esphome::host::advance(READING_INTERVAL);
+                                       ph.update();
+                                       bench::do_not_optimize(ph_sensors[0]->state); }));
+    results.push_back(bench::measure("tds_update", 16, [&]()
+                                     { esphome::host::advance(READING_INTERVAL);
+                                       tds.update();
+                                       bench::do_not_optimize(tds_sensors[0]->state); }));
+    tds.set_smoothing();
+    results.push_back(bench::measure("tds_update_smoothed", 16, [&]()
+                                     { esphome::host::advance(READING_INTERVAL);
+                                       tds.update();
+                                       bench::do_not_optimize(tds_sensors[0]->state); }));
+
+    // a dose seen through each filter, the level/trend filter with the
+    // defaults of GravityPhSensor::set_smoothing
+    std::vector<float> readings(READINGS);
+    noise = 7;
+    for (int i = 0; i < READINGS; i++)
+        readings[i] = true_ph(i) + READING_NOISE * gaussian(noise);
+
+    std::vector<Response> responses;
+    responses.push_back(respond("raw", readings, [](float value, uint32_t)
+                                { return value; }));
+    responses.push_back(moving_average("moving_average_10", readings, 10));
+    responses.push_back(moving_average("moving_average_20", readings, 20));
+    responses.push_back(moving_average("moving_average_40", readings, 40));
+    LevelTrendFilter dose;
+    dose.configure(0.0001f, 0.000005f, 0.005f);
+    responses.push_back(respond("level_trend", readings, [&](float value, uint32_t t)
+                                { return dose.step(value, READING_NOISE * READING_NOISE, t); }));
+
+    FILE *out = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (out == nullptr)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"filter\",\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const bench::Result &r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"iterations\": %ld}%s\n",
+                r.name.c_str(), r.ns_per_op, r.allocs_per_op, r.iterations, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"dose\": {\"interval_s\": %u, \"reading_noise_ph\": %.3f, \"responses\": [\n",
+            READING_INTERVAL / 1000, READING_NOISE);
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        const Response &r = responses[i];
+        fprintf(out, "    {\"name\": \"%s\", \"noise_ph\": %.4f, \"t90_s\": %.0f, \"overshoot_ph\": %.4f}%s\n", r.name,
+                r.noise, r.t90, r.overshoot, i + 1 < responses.size() ? "," : "");
+    }
+    fprintf(out, "  ]}\n}\n");
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
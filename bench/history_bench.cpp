@@ -0,0 +1,178 @@
+// Runs HistoryStore and WaterHistory on the host: checks ring wrap-around,
+// the clamping of long gaps between records, rollup period boundaries, the
+// get_history events and series fed by a publish policy, then reports the
+// cost of an insert. Exits with 1 when a check fails.
+//
+//   history_bench
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "history_store.h"
+#include "publish_policy.h"
+#include "water_history.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    failures += !ok;
+}
+
+struct Record
+{
+    uint32_t time;
+    float min, max, avg;
+};
+
+template <typename Store>
+static std::vector<Record> records(const Store &store, HistoryTier tier)
+{
+    std::vector<Record> out;
+    store.read(tier, 0, 0xFFFFFFFF, [&out](uint32_t time, float min, float max, float avg)
+               { out.push_back({time, min, max, avg}); });
+    return out;
+}
+
+static bool near(float a, float b)
+{
+    return std::fabs(a - b) < 0.01f;
+}
+
+int main()
+{
+    // a ring of 4 raw records after 10 pushes keeps the last 4, in order
+    {
+        HistoryRing<HistoryRawRecord, 4> ring;
+        for (uint16_t i = 0; i < 10; i++)
+            ring.push(i * 10, HistoryRawRecord{0, i});
+        std::vector<uint32_t> times;
+        std::vector<uint16_t> values;
+        ring.forEach([&](uint32_t time, const HistoryRawRecord &r)
+                     { times.push_back(time);
+                       values.push_back(r.value); });
+        check(ring.size() == 4 && ring.firstTime() == 60 && ring.lastTime() == 90, "wrap-around keeps the newest records");
+        check(times == std::vector<uint32_t>({60, 70, 80, 90}) && values == std::vector<uint16_t>({6, 7, 8, 9}),
+              "wrap-around reads oldest first with the right times");
+    }
+
+    // a gap longer than a 16 bit delta is shortened to 65535 s
+    {
+        HistoryRing<HistoryRawRecord, 4> ring;
+        ring.push(1000, HistoryRawRecord{0, 1});
+        ring.push(1000 + 100000, HistoryRawRecord{0, 2});
+        ring.push(1000 + 100010, HistoryRawRecord{0, 3});
+        std::vector<uint32_t> times;
+        ring.forEach([&](uint32_t time, const HistoryRawRecord &)
+                     { times.push_back(time); });
+        check(times == std::vector<uint32_t>({1000, 1000 + 65535, 1000 + 65535 + 34475}),
+              "long gaps are clamped to 65535 s, later deltas stay exact");
+    }
+
+    // values outside the range are clamped, NaN is kept as missing
+    {
+        HistoryStore<8, 2, 2, 2> store(0, 14);
+        store.insert(0, -3);
+        store.insert(15, 20);
+        store.insert(30, NAN);
+        const std::vector<Record> raw = records(store, HistoryTier::RAW);
+        check(raw.size() == 3 && near(raw[0].avg, 0) && near(raw[1].avg, 14) && std::isnan(raw[2].avg),
+              "raw values are clamped to the range, NaN reads as missing");
+    }
+
+    // a minute rollup closes with the first value of the next minute; a
+    // value at exactly 60 s belongs to the next period
+    {
+        HistoryStore<16, 4, 2, 2> store(0, 100);
+        store.insert(0, 10);
+        store.insert(15, 20);
+        store.insert(30, NAN);
+        store.insert(45, 30);
+        check(records(store, HistoryTier::MINUTE).empty(), "an open minute is not reported");
+        store.insert(60, 90);
+        std::vector<Record> minute = records(store, HistoryTier::MINUTE);
+        check(minute.size() == 1 && minute[0].time == 0 && near(minute[0].min, 10) && near(minute[0].max, 30) &&
+                  near(minute[0].avg, 20),
+              "the first minute holds min, max and avg of 0..59 s without the NaN");
+        store.insert(185, 50);
+        minute = records(store, HistoryTier::MINUTE);
+        check(minute.size() == 2 && minute[1].time == 60 && near(minute[1].avg, 90),
+              "a minute without samples is skipped, not reported empty");
+        for (uint32_t t = 240; t < 240 + 6 * 60; t += 60)
+            store.insert(t, t / 60.0f);
+        minute = records(store, HistoryTier::MINUTE);
+        check(minute.size() == 4 && minute.front().time == 300 && minute.back().time == 480,
+              "the minute tier wraps like the raw tier");
+        check(records(store, HistoryTier::QUARTER_HOUR).empty(), "the quarter hour is still open");
+        store.insert(900, 1);
+        const std::vector<Record> quarter = records(store, HistoryTier::QUARTER_HOUR);
+        check(quarter.size() == 1 && quarter[0].time == 0 && near(quarter[0].min, 4) && near(quarter[0].max, 90),
+              "the quarter hour closes at 900 s over all its samples");
+    }
+
+    // get_history over the API: one series, split into parts of HISTORY_RECORDS_PER_EVENT
+    {
+        esphome::sensor::Sensor ph;
+        WaterHistory history;
+        history.add_series("ph", &ph, 0, 14);
+        esphome::App.register_component(&history);
+        esphome::App.setup();
+        check(history.store(0) != nullptr && history.store(1) == nullptr, "only added series have a store");
+        for (int i = 0; i < 200; i++)
+        {
+            esphome::host::advance(15000);
+            ph.publish_state(7.0f + 0.001f * i);
+        }
+        history.call_service("get_history", {0, 0, 0});
+        const auto &events = history.fired_events();
+        int parts = 0;
+        size_t separators = 0;
+        for (const auto &event : events)
+        {
+            if (event.first != "esphome.water_history")
+                continue;
+            parts++;
+            const std::string &r = event.second.at("records");
+            for (char c : r)
+                separators += c == ';';
+        }
+        check(parts == 2 && separators == 200, "get_history sends all 200 raw records in 2 events");
+    }
+
+    // a series fed by a publish policy records the readings its deadband suppresses
+    {
+        esphome::App.reset();
+        esphome::sensor::Sensor tds;
+        PublishPolicy policy;
+        policy.set_deadband(1);
+        WaterHistory history;
+        history.add_series("tds", &policy, 0, 2000);
+        esphome::App.register_component(&history);
+        esphome::App.setup();
+        for (int i = 0; i < 8; i++)
+        {
+            esphome::host::advance(15000);
+            policy.publish(&tds, 300.0f + 0.1f * i);
+        }
+        const std::vector<Record> raw = records(*history.store(0), HistoryTier::RAW);
+        check(policy.sent() == 1 && raw.size() == 8 && near(raw.back().avg, 300.7f),
+              "a policy series records every reading, not only the published ones");
+    }
+
+    HistoryStore<240, 360, 384, 336> store(0, 14);
+    uint32_t time = 0;
+    const bench::Result insert = bench::measure("insert", 1, [&]()
+                                                { time += 15;
+                                                  store.insert(time, 7.0f); });
+    printf("\ninsert           %.1f ns, %.2f allocations\n", insert.ns_per_op, insert.allocs_per_op);
+    printf("store            %u bytes per series, WaterHistory %u bytes\n", (unsigned)sizeof(WaterHistoryStore),
+           (unsigned)sizeof(WaterHistory));
+
+    return failures == 0 ? 0 : 1;
+}
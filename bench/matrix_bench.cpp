@@ -0,0 +1,227 @@
+// Benchmarks the Matrix kernels and the pH calibration solve on the host, and
+// compares the expression templates against eager operators on typical filter
+// update expressions.
+// Results are written as JSON to stdout, or to the file given as argument.
+//
+//   matrix_bench [output.json]
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "FixedMatrix.h"
+#include "Matrix.h"
+#include "bench.h"
+#include "gravity_ph.h"
+
+// diagonally dominant, so every size is well conditioned and invertible
+static Matrix make_matrix(int n, int c, float seed)
+{
+    Matrix m(n, c);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < c; j++)
+            m[i][j] = std::sin(seed + i * 7 + j * 3) + (i == j ? n : 0);
+    return m;
+}
+
+// The operators as they were before expression templates: every call returns
+// a freshly allocated matrix.
+namespace eager
+{
+    static Matrix add(const Matrix &A, const Matrix &B)
+    {
+        Matrix tmp(A._row, A._column);
+        for (int i = 0; i < A._row; i++)
+            for (int j = 0; j < A._column; j++)
+                tmp[i][j] = A[i][j] + B[i][j];
+        return tmp;
+    }
+
+    static Matrix subtract(const Matrix &A, const Matrix &B)
+    {
+        Matrix tmp(A._row, A._column);
+        for (int i = 0; i < A._row; i++)
+            for (int j = 0; j < A._column; j++)
+                tmp[i][j] = A[i][j] - B[i][j];
+        return tmp;
+    }
+
+    static Matrix multiply(const Matrix &A, const Matrix &B)
+    {
+        Matrix tmp(A._row, B._column);
+        for (int i = 0; i < A._row; i++)
+        {
+            const float *row = A[i];
+            float *out = tmp[i];
+            for (int j = 0; j < B._column; j++)
+                for (int k = 0; k < A._column; k++)
+                    out[j] += row[k] * B[k][j];
+        }
+        return tmp;
+    }
+
+    static Matrix scale(const Matrix &A, float a)
+    {
+        Matrix tmp(A._row, A._column);
+        for (int i = 0; i < A._row; i++)
+            for (int j = 0; j < A._column; j++)
+                tmp[i][j] = A[i][j] * a;
+        return tmp;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<bench::Result> results;
+    const int sizes[] = {2, 3, 4, 6, 8, 12, 16, 24, 32};
+
+    for (int n : sizes)
+    {
+        Matrix A = make_matrix(n, n, 0.5f);
+        Matrix B = make_matrix(n, n, 1.5f);
+        Matrix v = make_matrix(n, 1, 2.5f);
+
+        results.push_back(bench::measure("solveFor", n, [&]()
+                                         { Matrix x = solveFor(A, v);
+                                           bench::do_not_optimize(x[0][0]); }));
+        results.push_back(bench::measure("inv", n, [&]()
+                                         { Matrix x = inv(A);
+                                           bench::do_not_optimize(x[0][0]); }));
+        results.push_back(bench::measure("lu_factor", n, [&]()
+                                         { LUDecomposition lu(A);
+                                           bench::do_not_optimize(lu.determinant()); }));
+        LUDecomposition lu(A);
+        Matrix x(n, 1);
+        results.push_back(bench::measure("lu_solve", n, [&]()
+                                         { lu.solveInto(v, x);
+                                           bench::do_not_optimize(x[0][0]); }));
+        results.push_back(bench::measure("operator*", n, [&]()
+                                         { Matrix x = A * B;
+                                           bench::do_not_optimize(x[0][0]); }));
+        results.push_back(bench::measure("operator*=", n, [&]()
+                                         { Matrix x = A;
+                                           x *= B;
+                                           bench::do_not_optimize(x[0][0]); }));
+        Matrix product(n, n), workspace(n, n);
+        results.push_back(bench::measure("multiply", n, [&]()
+                                         { multiply(product, A, B, workspace);
+                                           bench::do_not_optimize(product[0][0]); }));
+        // product = product * B through the workspace, copied back from A every time
+        results.push_back(bench::measure("multiply_aliased", n, [&]()
+                                         { product = A;
+                                           multiply(product, product, B, workspace);
+                                           bench::do_not_optimize(product[0][0]); }));
+        results.push_back(bench::measure("operator*=_reused", n, [&]()
+                                         { product = A;
+                                           product *= B;
+                                           bench::do_not_optimize(product[0][0]); }));
+        results.push_back(bench::measure("copy", n, [&]()
+                                         { Matrix x(A);
+                                           bench::do_not_optimize(x[0][0]); }));
+        results.push_back(bench::measure("move", n, [&]()
+                                         { Matrix x(std::move(A));
+                                           A = std::move(x);
+                                           bench::do_not_optimize(A[0][0]); }));
+    }
+
+    // filter updates: the state and covariance prediction and the state
+    // correction of a Kalman filter, and the general A*B + C*d
+    const int filterSizes[] = {2, 4, 8};
+    for (int n : filterSizes)
+    {
+        Matrix F = make_matrix(n, n, 0.5f);
+        Matrix Ft = transpose(F);
+        Matrix Q = make_matrix(n, n, 1.5f);
+        Matrix K = make_matrix(n, n, 2.5f);
+        Matrix H = make_matrix(n, n, 3.5f);
+        Matrix P = make_matrix(n, n, 4.5f);
+        Matrix x = make_matrix(n, 1, 5.5f);
+        Matrix z = make_matrix(n, 1, 6.5f);
+        Matrix out(n, n);
+        Matrix state(n, 1);
+
+        results.push_back(bench::measure("eager_predict_state", n, [&]()
+                                         { state = eager::add(eager::multiply(F, x), eager::scale(z, 0.5f));
+                                           bench::do_not_optimize(state[0][0]); }));
+        results.push_back(bench::measure("expr_predict_state", n, [&]()
+                                         { state = F * x + z * 0.5f;
+                                           bench::do_not_optimize(state[0][0]); }));
+        results.push_back(bench::measure("eager_predict_covariance", n, [&]()
+                                         { out = eager::add(eager::multiply(eager::multiply(F, P), Ft), Q);
+                                           bench::do_not_optimize(out[0][0]); }));
+        results.push_back(bench::measure("expr_predict_covariance", n, [&]()
+                                         { out = F * P * Ft + Q;
+                                           bench::do_not_optimize(out[0][0]); }));
+        Matrix FP(n, n), workspace(n, n);
+        results.push_back(bench::measure("workspace_predict_covariance", n, [&]()
+                                         { multiply(FP, F, P, workspace);
+                                           multiply(out, FP, Ft, workspace);
+                                           out += Q;
+                                           bench::do_not_optimize(out[0][0]); }));
+        results.push_back(bench::measure("eager_correct_state", n, [&]()
+                                         { state = eager::add(x, eager::multiply(K, eager::subtract(z, eager::multiply(H, x))));
+                                           bench::do_not_optimize(state[0][0]); }));
+        results.push_back(bench::measure("expr_correct_state", n, [&]()
+                                         { state = x + K * (z - H * x);
+                                           bench::do_not_optimize(state[0][0]); }));
+        results.push_back(bench::measure("eager_AB_plus_Cd", n, [&]()
+                                         { out = eager::add(eager::multiply(F, P), eager::scale(Q, 0.5f));
+                                           bench::do_not_optimize(out[0][0]); }));
+        results.push_back(bench::measure("expr_AB_plus_Cd", n, [&]()
+                                         { out = F * P + Q * 0.5f;
+                                           bench::do_not_optimize(out[0][0]); }));
+        // the destination inside the product takes a temporary
+        results.push_back(bench::measure("expr_aliased_A_AB", n, [&]()
+                                         { out = P;
+                                           out = out * F;
+                                           bench::do_not_optimize(out[0][0]); }));
+    }
+
+    // the 3x3 Vandermonde solve done by GravityPhSensor::onCalibrationChange,
+    // once with the dynamic Matrix and once with FixedMatrix as the sensor does now
+    volatile float x1 = PH_4_DEFAULT_VOLTAGE, x2 = PH_7_DEFAULT_VOLTAGE, x3 = PH_10_DEFAULT_VOLTAGE;
+    results.push_back(bench::measure("calibration_solve_matrix", 3, [&]()
+                                     {
+        float array1[3][3] = {{1, x1, x1 * x1}, {1, x2, x2 * x2}, {1, x3, x3 * x3}};
+        float array2[3][1] = {{4.0f}, {7.0f}, {10.0f}};
+        Matrix A(3, 3, (float *)array1);
+        Matrix B(3, 1, (float *)array2);
+        Matrix C = solveFor(A, B);
+        bench::do_not_optimize(C[2][0]); }));
+    results.push_back(bench::measure("calibration_solve_fixed", 3, [&]()
+                                     {
+        FixedMatrix<3, 1> C = quadraticThrough(x1, 4.0f, x2, 7.0f, x3, 10.0f);
+        bench::do_not_optimize(C[2][0]); }));
+
+    // a quadratic least-squares refit over the most points a calibration
+    // holds, its temporaries come from the calibration arena
+    float px[CALIBRATION_MAX_POINTS], py[CALIBRATION_MAX_POINTS];
+    for (int i = 0; i < CALIBRATION_MAX_POINTS; i++)
+    {
+        px[i] = 1.0f + 0.1f * i;
+        py[i] = 14.0f - 7.0f * px[i] + 0.3f * px[i] * px[i];
+    }
+    CalibrationCurve curve;
+    curve.setLeastSquaresDegree(2);
+    results.push_back(bench::measure("calibration_refit_arena", CALIBRATION_MAX_POINTS, [&]()
+                                     { bench::do_not_optimize(curve.fit(CalibrationStrategy::LEAST_SQUARES, px, py, CALIBRATION_MAX_POINTS)); }));
+    results.push_back(bench::measure("matrix_heap", 4, [&]()
+                                     { Matrix m(4, 4);
+                                       bench::do_not_optimize(m[0][0]); }));
+    StaticMatrixArena<256> scratch;
+    results.push_back(bench::measure("matrix_arena", 4, [&]()
+                                     { MatrixArenaScope scope(scratch);
+                                       Matrix m(4, 4);
+                                       bench::do_not_optimize(m[0][0]); }));
+
+    FILE *out = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (out == nullptr)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    bench::write_json(out, "matrix", results);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
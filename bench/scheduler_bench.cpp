@@ -0,0 +1,142 @@
+// Runs ProbeScheduler against the simulated clock of the host build: checks
+// the time of every action of a cycle, the settle gaps, that no two probes
+// are powered at once, the single publish pass after the last conversion and
+// the counting of overruns, then reports the cost of a cycle. Exits with 1
+// when a check fails.
+//
+//   scheduler_bench
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "probe_scheduler.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    failures += !ok;
+}
+
+struct Event
+{
+    uint32_t at;
+    std::string what;
+
+    bool operator==(const Event &e) const { return this->at == e.at && this->what == e.what; }
+};
+
+int main()
+{
+    // the timeline alone
+    {
+        ProbeTimeline timeline;
+        timeline.add(200, 3, 5);
+        timeline.add(300, 4, 10);
+        std::vector<Event> actions;
+        const char *names[] = {"on", "convert", "off", "publish", "done"};
+        for (timeline.restart(); timeline.current().step != ProbeStep::DONE; timeline.advance())
+        {
+            const ProbeAction &a = timeline.current();
+            actions.push_back({a.at, std::string(names[(int)a.step]) + std::to_string(a.channel)});
+        }
+        const std::vector<Event> expected = {
+            {0, "on0"}, {200, "convert0"}, {205, "convert0"}, {210, "convert0"}, {210, "off0"}, {210, "on1"},
+            {510, "convert1"}, {520, "convert1"}, {530, "convert1"}, {540, "convert1"}, {540, "off1"}, {540, "publish0"},
+        };
+        check(actions == expected, "timeline: every action at its time, settle gaps after each power on");
+        check(timeline.duration() == 540, "timeline: duration is the time of PUBLISH");
+    }
+
+    // a scheduler with two switched probes, on the simulated clock
+    std::vector<Event> log;
+    uint32_t start = 0;
+    auto record = [&log, &start](const std::string &what)
+    { log.push_back({esphome::millis() - start, what}); };
+
+    esphome::adc::ADCSensor ph_voltage;
+    esphome::adc::ADCSensor tds_voltage;
+    const float phSamples[] = {1.0f, 5.0f, 1.2f};
+    const float tdsSamples[] = {1.0f, 2.0f, 3.0f, 100.0f};
+    int phIndex = 0, tdsIndex = 0;
+    ph_voltage.set_signal([&]()
+                          { record("convert0");
+                            return phSamples[phIndex++ % 3]; });
+    tds_voltage.set_signal([&]()
+                           { record("convert1");
+                             return tdsSamples[tdsIndex++ % 4]; });
+    ph_voltage.add_on_state_callback([&](float)
+                                     { record("state0"); });
+    tds_voltage.add_on_state_callback([&](float)
+                                      { record("state1"); });
+
+    float phReading = NAN, tdsReading = NAN;
+    ProbeScheduler scheduler(15000);
+    scheduler.add_channel(&ph_voltage, [&](float v)
+                          { record("consume0");
+                            phReading = v; }, 200, 3, 5);
+    scheduler.add_channel(&tds_voltage, [&](float v)
+                          { record("consume1");
+                            tdsReading = v; }, 300, 4, 10, SampleReduction::TRIMMED_MEAN, 0.25f);
+    bool powered[2] = {false, false};
+    bool overlap = false;
+    for (int i = 0; i < 2; i++)
+        scheduler.set_power(i, [&, i](bool on)
+                            { record((on ? "on" : "off") + std::to_string(i));
+                              powered[i] = on;
+                              overlap = overlap || (powered[0] && powered[1]); });
+    esphome::App.register_component(&scheduler);
+    esphome::App.setup();
+    // setup switched both probes off
+    log.clear();
+
+    start = esphome::millis() + 15000;
+    esphome::App.run_for(15000 + 1000);
+    const std::vector<Event> expected = {
+        {0, "on0"}, {200, "convert0"}, {205, "convert0"}, {210, "convert0"}, {210, "off0"}, {210, "on1"},
+        {510, "convert1"}, {520, "convert1"}, {530, "convert1"}, {540, "convert1"}, {540, "off1"},
+        {540, "consume0"}, {540, "consume1"}, {540, "state0"}, {540, "state1"},
+    };
+    check(log == expected, "scheduler: actions happen at their time on the simulated clock");
+    check(!overlap, "scheduler: no two probes are powered at once");
+    check(phReading == 1.2f, "scheduler: the median of the pH conversions is consumed");
+    check(tdsReading == 2.5f, "scheduler: the trimmed mean uses the channel's trim");
+    check(ph_voltage.state == 1.2f && tds_voltage.state == 2.5f,
+          "scheduler: the readings are published on the ADC sensors after all consumers ran");
+    check(scheduler.cycles() == 1 && scheduler.overruns() == 0, "scheduler: one cycle, no overrun");
+
+    // a cycle of 540 ms every 400 ms: every other poll finds the cycle still running
+    esphome::App.reset();
+    ProbeScheduler tight(400);
+    esphome::adc::ADCSensor a, b;
+    a.set_level(1.0f);
+    b.set_level(2.0f);
+    int consumed = 0;
+    tight.add_channel(&a, [&](float)
+                      { consumed++; }, 200, 3, 5);
+    tight.add_channel(&b, [&](float)
+                      { consumed++; }, 300, 4, 10);
+    esphome::App.register_component(&tight);
+    esphome::App.setup();
+    esphome::App.run_for(2000);
+    check(tight.cycles() == 2 && tight.overruns() == 2 && consumed == 4,
+          "overrun: polls during a running cycle are counted and skipped");
+
+    // the cost of the work of one cycle, without waiting for the clock
+    esphome::App.reset();
+    ProbeScheduler timed(15000);
+    timed.add_channel(&a, [](float) {}, 0, 8, 0);
+    timed.add_channel(&b, [](float) {}, 0, 8, 0, SampleReduction::TRIMMED_MEAN, 0.25f);
+    const bench::Result cycle = bench::measure("cycle", 2, [&]()
+                                               { timed.update(); });
+    printf("\ncycle            %.1f ns for 2 channels of 8 conversions, %.2f allocations\n", cycle.ns_per_op,
+           cycle.allocs_per_op);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Runs GravityPhSensor and GravityTdsSensor against synthetic voltages on the
+// host and reports the cost of one update(), and of computing pH, TDS and TSS
+// over batches of water quality frames.
+//
+//   sensor_bench [iterations]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/application.h"
+#include "gravity_ph.h"
+#include "gravity_tds.h"
+#include "sample_source.h"
+#include "water_quality.h"
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+static double ns_per_call(long iterations, F &&f)
+{
+    auto start = Clock::now();
+    for (long i = 0; i < iterations; i++)
+        f(i);
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    const long iterations = argc > 1 ? std::atol(argv[1]) : 200000;
+
+    esphome::adc::ADCSensor ph_voltage;
+    esphome::adc::ADCSensor tds_voltage;
+    esphome::sensor::Sensor temperature;
+
+    // pH 7 +/- a slow swing, TDS around 300 ppm
+    ph_voltage.set_level(1.45f);
+    tds_voltage.set_level(0.45f);
+    temperature.publish_state(25.0f);
+
+    GravityPhSensor ph(&ph_voltage);
+    GravityTdsSensor tds(&tds_voltage, &temperature);
+    auto ph_sensors = ph.sensors();
+    auto tds_sensors = tds.sensors();
+    esphome::App.setup();
+
+    double ph_ns = ns_per_call(iterations, [&](long i)
+                               {
+        ph_voltage.publish_state(1.45f + 0.2f * std::sin(i * 1e-3f));
+        ph.update(); });
+    double tds_ns = ns_per_call(iterations, [&](long i)
+                                {
+        tds_voltage.publish_state(0.45f + 0.05f * std::sin(i * 1e-3f));
+        tds.update(); });
+
+    printf("GravityPhSensor::update   %8.1f ns  (pH %.3f)\n", ph_ns, ph_sensors[0]->state);
+    printf("GravityTdsSensor::update  %8.1f ns  (TDS %.1f ppm)\n", tds_ns, tds_sensors[0]->state);
+
+    // 16 sample bursts from a noisy ADC with occasional spikes
+    uint32_t noise = 1;
+    auto noisy = [&noise](float level)
+    {
+        noise = noise * 1664525u + 1013904223u;
+        float n = ((noise >> 8) & 0xffff) / 65536.0f - 0.5f;
+        return level + 0.02f * n + ((noise & 0xff) == 0 ? 0.5f : 0.0f);
+    };
+    ph_voltage.set_signal([&]()
+                          { return noisy(1.45f); });
+    tds_voltage.set_signal([&]()
+                           { return noisy(0.45f); });
+    ph.set_oversampling(16, SampleReduction::MEDIAN);
+    tds.set_oversampling(16, SampleReduction::TRIMMED_MEAN, 0.25f);
+
+    ph_ns = ns_per_call(iterations / 10, [&](long)
+                        { ph.update(); });
+    tds_ns = ns_per_call(iterations / 10, [&](long)
+                         { tds.update(); });
+
+    printf("16x median burst          %8.1f ns  (pH %.3f)\n", ph_ns, ph_sensors[0]->state);
+    printf("16x trimmed mean burst    %8.1f ns  (TDS %.1f ppm)\n", tds_ns, tds_sensors[0]->state);
+
+    // blocks from a simulated probe at pH 7: 1 kHz, 5 mV noise, 10 mV of
+    // 50 Hz hum; the spread of the readings shows what the filtering buys
+    SimulatedSampleSource probe(1.442f, 1000);
+    probe.set_noise(0.005f);
+    probe.set_hum(0.010f, 50);
+    ph.set_sample_source(&probe);
+    printf("\nsimulated probe, pH 7, 5 mV noise, 10 mV hum\n");
+    const uint8_t blocks[] = {1, 4, 20, 40, 64};
+    const SampleReduction reductions[] = {SampleReduction::MEDIAN, SampleReduction::TRIMMED_MEAN};
+    for (SampleReduction reduction : reductions)
+        for (uint8_t block : blocks)
+        {
+            ph.set_oversampling(block, reduction, 0.2f);
+            double sum = 0, squares = 0;
+            const long n = iterations / 50;
+            ph_ns = ns_per_call(n, [&](long)
+                                {
+                ph.update();
+                sum += ph_sensors[0]->state;
+                squares += ph_sensors[0]->state * ph_sensors[0]->state; });
+            const double mean = sum / n;
+            printf("%2u sample %-12s   %8.1f ns  (pH sd %.4f)\n", block,
+                   reduction == SampleReduction::MEDIAN ? "median" : "trimmed mean", ph_ns,
+                   std::sqrt(std::max(0.0, squares / n - mean * mean)));
+        }
+
+    // pH, TDS and TSS of one frame at a time against batches of frames
+    static WaterQualityBatch<64> batch;
+    for (size_t i = 0; i < 64; i++)
+        batch.add(i, 1.45f + 0.002f * i, 0.45f + 0.001f * i, 0.8f + 0.003f * i, 25.0f);
+    PolynomialCalibration tss;
+    const float tssCoefficients[3] = {TSS_DEFAULT_C0, TSS_DEFAULT_C1, TSS_DEFAULT_C2};
+    tss.set(tssCoefficients, 3);
+    const WaterQualityCalibration calibration = {&ph.calibration_curve(), tds.k_value(), &tss};
+    printf("\nwater quality frames\n");
+    const size_t batchSizes[] = {1, 8, 64};
+    float checksum = 0;
+    for (size_t size : batchSizes)
+    {
+        const long n = iterations / (long)size;
+        double frame_ns = ns_per_call(n, [&](long i)
+                                      {
+            WaterQualityFrames frames = batch.frames();
+            const size_t offset = (size_t)i * size % 64;
+            frames.count = std::min(size, 64 - offset);
+            frames.phVoltage += offset;
+            frames.tdsVoltage += offset;
+            frames.tssVoltage += offset;
+            frames.temperature += offset;
+            frames.ph += offset;
+            frames.tds += offset;
+            frames.tss += offset;
+            computeWaterQuality(frames, calibration);
+            checksum += frames.ph[0]; });
+        printf("batch of %2zu                %8.1f ns per frame\n", size, frame_ns / size);
+    }
+    printf("(pH %.3f  TDS %.1f ppm  TSS %.1f, checksum %.1f)\n", batch.ph[0], batch.tds[0], batch.tss[0], checksum);
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Compares the TDS conversion kernels against the original double precision
+// expression: cost per conversion and worst case error over the probe's range.
+// Results are written as JSON to stdout, or to the file given as argument.
+//
+//   tds_bench [output.json]
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "bench.h"
+#include "tds_kernel.h"
+
+static const int BLOCK = 1024;
+
+// the conversion as GravityTdsSensor::update() did it before the kernel
+static float reference(float v, float temperature, float kValue)
+{
+    float ec = (133.42 * v * v * v - 255.86 * v * v + 857.39 * v) * kValue;
+    float ec25 = ec / (1.0 + 0.02 * (temperature - 25.0));
+    return ec25 * TdsFactor;
+}
+
+// the same in long double, the yardstick for the error bounds
+static long double exact(long double v, long double temperature, long double kValue)
+{
+    long double ec = (133.42L * v * v * v - 255.86L * v * v + 857.39L * v) * kValue;
+    return ec / (1.0L + 0.02L * (temperature - 25.0L)) * 0.5L;
+}
+
+static double cycles_per_conversion(double ns_per_block, bool &available)
+{
+#ifdef HAVE_TSC
+    // calibrate the TSC rate against the steady clock
+    using Clock = std::chrono::steady_clock;
+    auto t0 = Clock::now();
+    unsigned long long c0 = __rdtsc();
+    while (std::chrono::duration<double, std::milli>(Clock::now() - t0).count() < 20)
+    {
+    }
+    unsigned long long c1 = __rdtsc();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    available = true;
+    return ns_per_block / BLOCK * (c1 - c0) / ns;
+#else
+    available = false;
+    return 0;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<float> volts(BLOCK);
+    std::vector<q16_16> voltsQ16(BLOCK);
+    std::vector<float> out(BLOCK);
+    std::vector<q16_16> outQ16(BLOCK);
+    for (int i = 0; i < BLOCK; i++)
+    {
+        volts[i] = 2.3f * i / BLOCK;
+        voltsQ16[i] = toQ16(volts[i]);
+    }
+
+    const float temperature = 26.5f;
+    const float kValue = 1.07f;
+    TdsKernel kernel;
+    kernel.setCompensation(kValue, temperature);
+
+    std::vector<bench::Result> results;
+    results.push_back(bench::measure("double_reference", BLOCK, [&]()
+                                     { for (int i = 0; i < BLOCK; i++)
+                                         out[i] = reference(volts[i], temperature, kValue);
+                                       bench::do_not_optimize(out[BLOCK - 1]); }));
+    results.push_back(bench::measure("float_kernel", BLOCK, [&]()
+                                     { for (int i = 0; i < BLOCK; i++)
+                                         out[i] = kernel.convert(volts[i]);
+                                       bench::do_not_optimize(out[BLOCK - 1]); }));
+    results.push_back(bench::measure("q16_kernel", BLOCK, [&]()
+                                     { for (int i = 0; i < BLOCK; i++)
+                                         outQ16[i] = kernel.convertQ16(voltsQ16[i]);
+                                       bench::do_not_optimize(outQ16[BLOCK - 1]); }));
+
+    // worst case error against long double over 0..2.3 V and 0..40 C
+    double errReference = 0, errFloat = 0, errQ16 = 0;
+    for (int t = 0; t <= 40; t += 2)
+    {
+        TdsKernel k;
+        k.setCompensation(kValue, t);
+        for (int i = 0; i <= 2300; i++)
+        {
+            const float v = i / 1000.0f;
+            const long double e = exact(v, t, kValue);
+            errReference = fmax(errReference, fabs((double)(reference(v, t, kValue) - e)));
+            errFloat = fmax(errFloat, fabs((double)(k.convert(v) - e)));
+            errQ16 = fmax(errQ16, fabs((double)(fromQ16(k.convertQ16(toQ16(v))) - e)));
+        }
+    }
+
+    FILE *f = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (f == nullptr)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fprintf(f, "{\n  \"benchmark\": \"tds\",\n  \"conversions_per_op\": %d,\n  \"results\": [\n", BLOCK);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        bool tsc;
+        double cycles = cycles_per_conversion(results[i].ns_per_op, tsc);
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_conversion\": %.3f, \"cycles_per_conversion\": %s, \"allocs_per_op\": %.3f}%s\n",
+                results[i].name.c_str(), results[i].ns_per_op / BLOCK, tsc ? std::to_string(cycles).c_str() : "null",
+                results[i].allocs_per_op, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"max_abs_error_ppm\": {\"double_reference\": %.5f, \"float_kernel\": %.5f, \"q16_kernel\": %.5f}\n}\n",
+            errReference, errFloat, errQ16);
+    if (f != stdout)
+        fclose(f);
+    return 0;
+}
@@ -0,0 +1,295 @@
+// Replays a recorded trace of probe voltages through GravityPhSensor and
+// GravityTdsSensor on the host, with the calibration events of the trace
+// interleaved, and reports throughput, per-sample latency and heap
+// allocations per sample and per event.
+//
+//   trace_replay trace.csv|trace.bin [--event-driven] [--repeat N]
+//                [--json out.json] [--write-binary out.bin]
+//
+// CSV traces have a header line and the columns
+//
+//   t_ms,ph_v,tds_v,temp,event,arg
+//
+// t_ms is the time since the start of the recording, ph_v and tds_v are the
+// ADC voltages, temp is the state of the temperature sensor. event is empty or
+// the name of a pH API service (begin_calibration, calibration_point_acid,
+// ...) or tds_calibrate, called with arg after the sample. Binary traces are
+// the "AQTR" header followed by TraceRecord structs, see --write-binary.
+//
+// Every sample is published on the ADC sensors, then update() is called on
+// both sensors. With --event-driven the sensors compute on the publish
+// instead, which is the path set_event_driven(true) takes on the device.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/preferences.h"
+#include "gravity_ph.h"
+#include "gravity_tds.h"
+
+static const char TRACE_MAGIC[4] = {'A', 'Q', 'T', 'R'};
+static const uint32_t TRACE_VERSION = 1;
+
+enum class TraceEvent : uint8_t
+{
+    NONE = 0,
+    PH_SERVICE,
+    TDS_CALIBRATE,
+};
+
+struct TraceRecord
+{
+    uint32_t t_ms;
+    float ph_v;
+    float tds_v;
+    float temp;
+    float arg;
+    TraceEvent event;
+    // pH service name for PH_SERVICE events
+    char service[27];
+};
+
+static bool parseCsv(FILE *in, std::vector<TraceRecord> &trace)
+{
+    char line[256];
+    if (!fgets(line, sizeof(line), in))
+        return false;
+    // the header line is skipped
+
+    int number = 1;
+    while (fgets(line, sizeof(line), in))
+    {
+        number++;
+        if (line[0] == '\n' || line[0] == '#')
+            continue;
+
+        TraceRecord r = {};
+        char event[64] = "";
+        const int fields = sscanf(line, "%u,%f,%f,%f,%63[^,\n],%f", &r.t_ms, &r.ph_v, &r.tds_v, &r.temp, event, &r.arg);
+        if (fields < 4)
+        {
+            fprintf(stderr, "line %d: expected t_ms,ph_v,tds_v,temp[,event,arg]\n", number);
+            return false;
+        }
+        if (fields >= 5 && event[0] != '\0')
+        {
+            if (strcmp(event, "tds_calibrate") == 0)
+                r.event = TraceEvent::TDS_CALIBRATE;
+            else if (strlen(event) < sizeof(r.service))
+            {
+                r.event = TraceEvent::PH_SERVICE;
+                strcpy(r.service, event);
+            }
+            else
+            {
+                fprintf(stderr, "line %d: unknown event %s\n", number, event);
+                return false;
+            }
+        }
+        trace.push_back(r);
+    }
+    return true;
+}
+
+static bool readTrace(const char *path, std::vector<TraceRecord> &trace)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        perror(path);
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version;
+    bool ok;
+    if (fread(magic, 1, 4, in) == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0)
+    {
+        ok = fread(&version, sizeof(version), 1, in) == 1 && version == TRACE_VERSION;
+        TraceRecord r;
+        while (ok && fread(&r, sizeof(r), 1, in) == 1)
+            trace.push_back(r);
+    }
+    else
+    {
+        rewind(in);
+        ok = parseCsv(in, trace);
+    }
+    fclose(in);
+    return ok;
+}
+
+static bool writeTrace(const char *path, const std::vector<TraceRecord> &trace)
+{
+    FILE *out = fopen(path, "wb");
+    if (!out)
+    {
+        perror(path);
+        return false;
+    }
+    fwrite(TRACE_MAGIC, 1, 4, out);
+    fwrite(&TRACE_VERSION, sizeof(TRACE_VERSION), 1, out);
+    fwrite(trace.data(), sizeof(TraceRecord), trace.size(), out);
+    return fclose(out) == 0;
+}
+
+static double percentile(std::vector<double> sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+int main(int argc, char **argv)
+{
+    const char *tracePath = nullptr;
+    const char *jsonPath = nullptr;
+    const char *binaryPath = nullptr;
+    bool eventDriven = false;
+    long repeat = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--event-driven") == 0)
+            eventDriven = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = std::max(1L, std::atol(argv[++i]));
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--write-binary") == 0 && i + 1 < argc)
+            binaryPath = argv[++i];
+        else
+            tracePath = argv[i];
+    }
+    if (tracePath == nullptr)
+    {
+        fprintf(stderr, "usage: %s trace.csv|trace.bin [--event-driven] [--repeat N] [--json out.json] [--write-binary out.bin]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TraceRecord> trace;
+    if (!readTrace(tracePath, trace) || trace.empty())
+    {
+        fprintf(stderr, "%s: no samples\n", tracePath);
+        return 1;
+    }
+    if (binaryPath != nullptr)
+        return writeTrace(binaryPath, trace) ? 0 : 1;
+
+    esphome::adc::ADCSensor ph_voltage;
+    esphome::adc::ADCSensor tds_voltage;
+    esphome::sensor::Sensor temperature;
+    GravityPhSensor ph(&ph_voltage);
+    GravityTdsSensor tds(&tds_voltage, &temperature);
+    if (eventDriven)
+    {
+        ph.set_event_driven(true);
+        tds.set_event_driven(true);
+    }
+    auto ph_sensors = ph.sensors();
+    auto tds_sensors = tds.sensors();
+    esphome::App.setup();
+
+    using Clock = std::chrono::steady_clock;
+    const size_t samples = trace.size() * repeat;
+    std::vector<double> latency;
+    latency.reserve(samples);
+    uint64_t sampleAllocations = 0, sampleBytes = 0, allocatingSamples = 0;
+    uint64_t eventAllocations = 0, eventBytes = 0, events = 0;
+    double sampleNs = 0, eventNs = 0;
+    const uint32_t writesBefore = esphome::global_preferences->write_count();
+
+    uint32_t elapsed = 0;
+    for (long pass = 0; pass < repeat; pass++)
+    {
+        const uint32_t offset = esphome::millis();
+        for (const TraceRecord &r : trace)
+        {
+            // the clock follows the recording, timers of the sensors fire on the way
+            const uint32_t due = offset + r.t_ms;
+            if ((int32_t)(due - esphome::millis()) > 0)
+                esphome::App.run_for(due - esphome::millis());
+
+            ph_voltage.set_level(r.ph_v);
+            tds_voltage.set_level(r.tds_v);
+
+            auto allocs = alloc_counter::snapshot();
+            auto start = Clock::now();
+            temperature.publish_state(r.temp);
+            ph_voltage.update();
+            tds_voltage.update();
+            if (!eventDriven)
+            {
+                ph.update();
+                tds.update();
+            }
+            std::chrono::duration<double, std::nano> took = Clock::now() - start;
+            auto used = alloc_counter::snapshot() - allocs;
+
+            latency.push_back(took.count());
+            sampleNs += took.count();
+            sampleAllocations += used.allocations;
+            sampleBytes += used.bytes;
+            allocatingSamples += used.allocations > 0;
+
+            if (r.event == TraceEvent::NONE)
+                continue;
+
+            // built outside the measurement, they are the harness' allocations
+            const std::string service = r.service;
+            const std::vector<float> args = {r.arg};
+            allocs = alloc_counter::snapshot();
+            start = Clock::now();
+            if (r.event == TraceEvent::TDS_CALIBRATE)
+                tds.calibrate(r.arg);
+            else if (!ph.call_service(service, args))
+                fprintf(stderr, "t=%u ms: no pH service %s\n", r.t_ms, r.service);
+            took = Clock::now() - start;
+            used = alloc_counter::snapshot() - allocs;
+            eventNs += took.count();
+            eventAllocations += used.allocations;
+            eventBytes += used.bytes;
+            events++;
+        }
+        elapsed += trace.back().t_ms;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    printf("%s: %zu samples, %llu events, %.1f h of recording%s\n", tracePath, samples, (unsigned long long)events,
+           elapsed / 3600000.0, eventDriven ? ", event driven" : "");
+    printf("throughput       %12.0f samples/s\n", samples / (sampleNs * 1e-9));
+    printf("latency          mean %.0f ns  p50 %.0f ns  p99 %.0f ns  max %.0f ns\n", sampleNs / samples,
+           percentile(latency, 0.5), percentile(latency, 0.99), latency.back());
+    printf("allocations      %.3f per sample (%llu samples allocated), %.1f bytes per sample\n",
+           double(sampleAllocations) / samples, (unsigned long long)allocatingSamples, double(sampleBytes) / samples);
+    if (events > 0)
+        printf("events           %.0f ns, %.2f allocations, %.1f bytes per event\n", eventNs / events,
+               double(eventAllocations) / events, double(eventBytes) / events);
+    printf("flash writes     %u\n", esphome::global_preferences->write_count() - writesBefore);
+    printf("last reading     pH %.3f  TDS %.1f ppm\n", ph_sensors[0]->state, tds_sensors[0]->state);
+
+    if (jsonPath != nullptr)
+    {
+        FILE *out = fopen(jsonPath, "w");
+        if (!out)
+        {
+            perror(jsonPath);
+            return 1;
+        }
+        std::vector<bench::Result> results = {
+            {"sample", 1, sampleNs / samples, double(sampleAllocations) / samples, double(sampleBytes) / samples, (long)samples},
+        };
+        if (events > 0)
+            results.push_back({"event", 1, eventNs / events, double(eventAllocations) / events, double(eventBytes) / events, (long)events});
+        bench::write_json(out, "trace_replay", results);
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+// Host stand-in for the Arduino core, just enough for the sensors in include/
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "esphome/core/hal.h"
+
+using esphome::delay;
+using esphome::micros;
+using esphome::millis;
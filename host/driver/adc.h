@@ -0,0 +1,114 @@
+// Host stand-in for the continuous (adc_digi) part of the ESP-IDF 4.4
+// driver/adc.h. The controller converts the signal installed with
+// esphome::host::set_adc_digi_signal() at sample_freq_hz on the simulated
+// clock into a ring of max_store_buf_size bytes. Like the driver, it drops new
+// conversions while the ring is full and reports that once with
+// ESP_ERR_INVALID_STATE from the next adc_digi_read_bytes(); a read that has
+// to wait advances the simulated clock.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "esp_err.h"
+
+typedef enum
+{
+    ADC1_CHANNEL_0 = 0,
+    ADC1_CHANNEL_1,
+    ADC1_CHANNEL_2,
+    ADC1_CHANNEL_3,
+    ADC1_CHANNEL_4,
+    ADC1_CHANNEL_5,
+    ADC1_CHANNEL_6,
+    ADC1_CHANNEL_7,
+} adc1_channel_t;
+
+typedef enum
+{
+    ADC_ATTEN_DB_0 = 0,
+    ADC_ATTEN_DB_2_5 = 1,
+    ADC_ATTEN_DB_6 = 2,
+    ADC_ATTEN_DB_11 = 3,
+} adc_atten_t;
+
+typedef enum
+{
+    ADC_UNIT_1 = 1,
+} adc_unit_t;
+
+typedef enum
+{
+    ADC_WIDTH_BIT_12 = 3,
+} adc_bits_width_t;
+
+typedef enum
+{
+    ADC_CONV_SINGLE_UNIT_1 = 1,
+} adc_digi_convert_mode_t;
+
+typedef enum
+{
+    ADC_DIGI_OUTPUT_FORMAT_TYPE1 = 0,
+} adc_digi_output_format_t;
+
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+
+typedef struct
+{
+    uint32_t max_store_buf_size;
+    uint32_t conv_num_each_intr;
+    uint32_t adc1_chan_mask;
+    uint32_t adc2_chan_mask;
+} adc_digi_init_config_t;
+
+typedef struct
+{
+    uint8_t atten;
+    uint8_t channel;
+    uint8_t unit;
+    uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct
+{
+    bool conv_limit_en;
+    uint32_t conv_limit_num;
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t *adc_pattern;
+    uint32_t sample_freq_hz;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_digi_configuration_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint16_t data : 12;
+            uint16_t channel : 4;
+        } type1;
+        uint16_t val;
+    };
+} adc_digi_output_data_t;
+
+esp_err_t adc_digi_initialize(const adc_digi_init_config_t *init_config);
+esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t *config);
+esp_err_t adc_digi_start();
+esp_err_t adc_digi_stop();
+esp_err_t adc_digi_deinitialize();
+esp_err_t adc_digi_read_bytes(uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms);
+
+namespace esphome
+{
+    namespace host
+    {
+        // every conversion of the continuous controller reads whatever the
+        // signal yields next, in V over a 0..3.3 V range
+        void set_adc_digi_signal(std::function<float()> &&signal);
+        // conversions the controller dropped because the ring was full
+        uint32_t adc_digi_dropped();
+    }
+}
@@ -0,0 +1,21 @@
+// Host stand-in for the ESP-IDF esp_adc_cal.h: an ideal linear 12 bit
+// characteristic over 0..3.3 V
+#pragma once
+
+#include <cstdint>
+
+#include "driver/adc.h"
+
+typedef struct
+{
+    uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+typedef enum
+{
+    ESP_ADC_CAL_VAL_DEFAULT_VREF = 2,
+} esp_adc_cal_value_t;
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t *chars);
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars);
@@ -0,0 +1,182 @@
+// Implementation of the host stand-ins for the ESP-IDF drivers in host/. None
+// of this is compiled for a device.
+#include <cmath>
+#include <cstring>
+#include <deque>
+
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#include "esp_err.h"
+#include "esphome/core/hal.h"
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    }
+    return "UNKNOWN ERROR";
+}
+
+// --- continuous ADC ----------------------------------------------------------
+
+namespace
+{
+    struct DigiController
+    {
+        bool initialized = false;
+        bool configured = false;
+        bool running = false;
+        // ring capacity in conversions
+        uint32_t capacity = 0;
+        uint32_t channelMask = 0;
+        uint8_t channel = 0;
+        uint32_t rate = 0;
+        // simulated time conversions are counted from, and how many were made since
+        uint64_t startUs = 0;
+        uint64_t converted = 0;
+        bool overflow = false;
+        uint32_t dropped = 0;
+        std::deque<uint16_t> ring;
+        std::function<float()> signal;
+    };
+
+    DigiController digi;
+
+    // makes every conversion that is due at the current simulated time
+    void convert()
+    {
+        if (!digi.running)
+            return;
+        const uint64_t due = (esphome::host::now_micros() - digi.startUs) * digi.rate / 1000000;
+        for (; digi.converted < due; digi.converted++)
+        {
+            const float v = digi.signal ? digi.signal() : 0;
+            const float raw = std::round(v / 3.3f * 4095);
+            adc_digi_output_data_t out;
+            out.type1.data = raw < 0 ? 0 : (raw > 4095 ? 4095 : (uint16_t)raw);
+            out.type1.channel = digi.channel;
+            if (digi.ring.size() < digi.capacity)
+                digi.ring.push_back(out.val);
+            else
+            {
+                digi.overflow = true;
+                digi.dropped++;
+            }
+        }
+    }
+}
+
+esp_err_t adc_digi_initialize(const adc_digi_init_config_t *init_config)
+{
+    if (digi.initialized)
+        return ESP_ERR_INVALID_STATE;
+    if (init_config->adc1_chan_mask == 0 || init_config->max_store_buf_size < sizeof(adc_digi_output_data_t))
+        return ESP_ERR_INVALID_ARG;
+    std::function<float()> signal = std::move(digi.signal);
+    digi = DigiController{};
+    digi.signal = std::move(signal);
+    digi.initialized = true;
+    digi.capacity = init_config->max_store_buf_size / sizeof(adc_digi_output_data_t);
+    digi.channelMask = init_config->adc1_chan_mask;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t *config)
+{
+    if (!digi.initialized || config->pattern_num != 1 || config->adc_pattern == nullptr)
+        return ESP_ERR_INVALID_STATE;
+    // the ESP32 controller runs from 20 kHz to 2 MHz
+    if (config->sample_freq_hz < 20000 || config->sample_freq_hz > 2000000)
+        return ESP_ERR_INVALID_ARG;
+    digi.channel = config->adc_pattern->channel;
+    digi.rate = config->sample_freq_hz;
+    digi.configured = true;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_start()
+{
+    if (!digi.configured)
+        return ESP_ERR_INVALID_STATE;
+    digi.running = true;
+    digi.startUs = esphome::host::now_micros();
+    digi.converted = 0;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_stop()
+{
+    convert();
+    digi.running = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_deinitialize()
+{
+    std::function<float()> signal = std::move(digi.signal);
+    digi = DigiController{};
+    digi.signal = std::move(signal);
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_read_bytes(uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms)
+{
+    *out_length = 0;
+    if (!digi.initialized)
+        return ESP_ERR_INVALID_STATE;
+
+    convert();
+    // waiting for the DMA is waiting on the simulated clock
+    for (uint32_t waited = 0; digi.ring.empty() && digi.running && waited < timeout_ms; waited++)
+    {
+        esphome::host::advance(1);
+        convert();
+    }
+    if (digi.ring.empty())
+        return ESP_ERR_TIMEOUT;
+
+    uint32_t n = 0;
+    while (n < length_max / sizeof(adc_digi_output_data_t) && !digi.ring.empty())
+    {
+        const uint16_t val = digi.ring.front();
+        std::memcpy(buf + n * sizeof(val), &val, sizeof(val));
+        digi.ring.pop_front();
+        n++;
+    }
+    *out_length = n * sizeof(adc_digi_output_data_t);
+
+    const bool overflow = digi.overflow;
+    digi.overflow = false;
+    return overflow ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t *chars)
+{
+    chars->vref = default_vref;
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars)
+{
+    return (adc_reading * 3300 + 2047) / 4095;
+}
+
+namespace esphome
+{
+    namespace host
+    {
+        void set_adc_digi_signal(std::function<float()> &&signal) { digi.signal = std::move(signal); }
+        uint32_t adc_digi_dropped() { return digi.dropped; }
+    }
+}
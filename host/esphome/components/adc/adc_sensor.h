@@ -0,0 +1,57 @@
+// Host stand-in for esphome/components/adc/adc_sensor.h. sample() reads the
+// signal installed with set_signal(), so tools can feed synthetic or recorded
+// voltages.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/core/component.h"
+
+namespace esphome
+{
+    namespace voltage_sampler
+    {
+        class VoltageSampler
+        {
+        public:
+            virtual ~VoltageSampler() = default;
+            virtual float sample() = 0;
+        };
+    }
+
+    namespace adc
+    {
+        class ADCSensor : public sensor::Sensor, public PollingComponent, public voltage_sampler::VoltageSampler
+        {
+        public:
+            ADCSensor() : PollingComponent(15000) {}
+
+            void update() override { this->publish_state(this->sample()); }
+
+            float sample() override
+            {
+                this->conversions_++;
+                return this->signal_ ? this->signal_() : this->level_;
+            }
+
+            // every conversion returns whatever the signal yields next
+            void set_signal(std::function<float()> &&signal) { this->signal_ = std::move(signal); }
+            // every conversion returns the same voltage
+            void set_level(float level)
+            {
+                this->signal_ = nullptr;
+                this->level_ = level;
+            }
+
+            // number of sample() calls, i.e. ADC conversions on a device
+            uint32_t conversion_count() const { return this->conversions_; }
+
+        protected:
+            std::function<float()> signal_;
+            float level_{0};
+            uint32_t conversions_{0};
+        };
+    }
+}
@@ -0,0 +1,76 @@
+// Host stand-in for esphome/components/api/custom_api_device.h. Registered
+// services can be invoked by name with numeric arguments.
+#pragma once
+
+#include <array>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace esphome
+{
+    namespace api
+    {
+        class CustomAPIDevice
+        {
+        public:
+            template <typename T, typename... Ts>
+            void register_service(void (T::*callback)(Ts...), const std::string &name,
+                                  const std::array<std::string, sizeof...(Ts)> &arg_names)
+            {
+                (void)arg_names;
+                T *obj = static_cast<T *>(this);
+                this->services_[name] = [obj, callback](const std::vector<float> &args)
+                {
+                    return invoke_(obj, callback, args, std::index_sequence_for<Ts...>{});
+                };
+            }
+
+            template <typename T>
+            void register_service(void (T::*callback)(), const std::string &name)
+            {
+                T *obj = static_cast<T *>(this);
+                this->services_[name] = [obj, callback](const std::vector<float> &)
+                {
+                    (obj->*callback)();
+                    return true;
+                };
+            }
+
+            // false when no service with this name exists or too few arguments were given
+            bool call_service(const std::string &name, const std::vector<float> &args = {})
+            {
+                auto it = this->services_.find(name);
+                if (it == this->services_.end())
+                    return false;
+                return it->second(args);
+            }
+
+            void fire_homeassistant_event(const std::string &event_name, const std::map<std::string, std::string> &data = {})
+            {
+                this->events_.emplace_back(event_name, data);
+            }
+
+            // events fired so far, oldest first
+            const std::vector<std::pair<std::string, std::map<std::string, std::string>>> &fired_events() const
+            {
+                return this->events_;
+            }
+
+        protected:
+            template <typename T, typename... Ts, size_t... S>
+            static bool invoke_(T *obj, void (T::*callback)(Ts...), const std::vector<float> &args, std::index_sequence<S...>)
+            {
+                if (args.size() < sizeof...(Ts))
+                    return false;
+                (obj->*callback)(static_cast<Ts>(args[S])...);
+                return true;
+            }
+
+            std::map<std::string, std::function<bool(const std::vector<float> &)>> services_;
+            std::vector<std::pair<std::string, std::map<std::string, std::string>>> events_;
+        };
+    }
+}
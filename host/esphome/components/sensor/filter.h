@@ -0,0 +1,44 @@
+// Host stand-in for esphome/components/sensor/filter.h, only the filters used in include/
+#pragma once
+
+#include <vector>
+
+#include "esphome/core/optional.h"
+
+namespace esphome
+{
+    namespace sensor
+    {
+        class Filter
+        {
+        public:
+            virtual ~Filter() = default;
+            virtual optional<float> new_value(float value) = 0;
+        };
+
+        class ClampFilter : public Filter
+        {
+        public:
+            ClampFilter(float min, float max, bool ignore_out_of_range)
+                : min_(min), max_(max), ignore_out_of_range_(ignore_out_of_range) {}
+
+            optional<float> new_value(float value) override;
+
+        protected:
+            float min_;
+            float max_;
+            bool ignore_out_of_range_;
+        };
+
+        class CalibratePolynomialFilter : public Filter
+        {
+        public:
+            CalibratePolynomialFilter(std::vector<float> coefficients) : coefficients_(std::move(coefficients)) {}
+
+            optional<float> new_value(float value) override;
+
+        protected:
+            std::vector<float> coefficients_;
+        };
+    }
+}
@@ -0,0 +1,66 @@
+// Host stand-in for esphome/components/sensor/sensor.h
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "esphome/core/component.h"
+#include "esphome/core/log.h"
+
+namespace esphome
+{
+    class EntityBase
+    {
+    public:
+        EntityBase();
+
+        const std::string &get_name() const { return this->name_; }
+        void set_name(const std::string &name) { this->name_ = name; }
+
+        // stable per instance on the host, ESPHome derives it from the object id
+        uint32_t get_object_id_hash() const { return this->object_id_hash_; }
+
+    protected:
+        std::string name_;
+        uint32_t object_id_hash_;
+    };
+
+    namespace sensor
+    {
+        class Filter;
+
+        class Sensor : public EntityBase
+        {
+        public:
+            void publish_state(float state);
+
+            void add_on_state_callback(std::function<void(float)> &&callback)
+            {
+                this->callbacks_.push_back(std::move(callback));
+            }
+            void add_on_raw_state_callback(std::function<void(float)> &&callback)
+            {
+                this->raw_callbacks_.push_back(std::move(callback));
+            }
+
+            float get_state() const { return this->state; }
+            float get_raw_state() const { return this->raw_state; }
+            bool has_state() const { return this->has_state_; }
+
+            // number of publish_state() calls, the host equivalent of API traffic
+            uint32_t publish_count() const { return this->publish_count_; }
+
+            float state{NAN};
+            float raw_state{NAN};
+
+        protected:
+            std::vector<std::function<void(float)>> callbacks_;
+            std::vector<std::function<void(float)>> raw_callbacks_;
+            bool has_state_{false};
+            uint32_t publish_count_{0};
+        };
+    }
+}
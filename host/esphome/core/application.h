@@ -0,0 +1,58 @@
+// Host stand-in for esphome/core/application.h. Besides keeping the component
+// list it runs the scheduler against the simulated clock from hal.h.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "esphome/core/component.h"
+
+namespace esphome
+{
+    class Application
+    {
+    public:
+        template <class C>
+        C *register_component(C *c)
+        {
+            this->components_.push_back(c);
+            return c;
+        }
+
+        // calls call_setup() on every registered component, highest priority first
+        void setup();
+        // runs every scheduled item that is due at the current simulated time
+        void loop();
+        // advances the simulated clock to now + ms, running scheduled items on the way
+        void run_for(uint32_t ms);
+
+        const std::vector<Component *> &get_components() const { return this->components_; }
+
+        // forgets all components and scheduled items
+        void reset();
+
+        // scheduler backend for Component::set_interval/set_timeout
+        void schedule(Component *component, const std::string &name, uint32_t delay, bool repeat,
+                      std::function<void()> &&f);
+        bool cancel(Component *component, const std::string &name, bool repeat);
+
+    protected:
+        struct Item
+        {
+            Component *component;
+            std::string name;
+            uint64_t next_us;
+            uint32_t interval;
+            bool repeat;
+            bool removed;
+            std::function<void()> f;
+        };
+
+        std::vector<Component *> components_;
+        std::vector<Item> items_;
+    };
+
+    extern Application App;
+}
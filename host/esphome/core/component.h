@@ -0,0 +1,73 @@
+// Host stand-in for esphome/core/component.h
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/optional.h"
+
+namespace esphome
+{
+    namespace setup_priority
+    {
+        extern const float BUS;
+        extern const float IO;
+        extern const float HARDWARE;
+        extern const float DATA;
+        extern const float PROCESSOR;
+        extern const float AFTER_WIFI;
+        extern const float AFTER_CONNECTION;
+        extern const float LATE;
+    }
+
+    static const uint32_t SCHEDULER_DONT_RUN = 4294967295UL;
+
+    class Component
+    {
+    public:
+        virtual ~Component() = default;
+
+        virtual void setup() {}
+        virtual void loop() {}
+        virtual void dump_config() {}
+        virtual float get_setup_priority() const { return setup_priority::DATA; }
+
+        // called by Application::setup(), PollingComponent uses it to start its poller
+        virtual void call_setup() { this->setup(); }
+
+        void mark_failed() { this->failed_ = true; }
+        bool is_failed() const { return this->failed_; }
+
+    protected:
+        void set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f);
+        bool cancel_interval(const std::string &name);
+        void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f);
+        bool cancel_timeout(const std::string &name);
+        void defer(std::function<void()> &&f) { this->set_timeout("", 0, std::move(f)); }
+
+        bool failed_{false};
+    };
+
+    class PollingComponent : public Component
+    {
+    public:
+        PollingComponent() : PollingComponent(0) {}
+        explicit PollingComponent(uint32_t update_interval) : update_interval_(update_interval) {}
+
+        virtual void update() = 0;
+
+        void call_setup() override;
+
+        // like ESPHome this only stores the value, start_poller() applies it
+        virtual void set_update_interval(uint32_t update_interval) { this->update_interval_ = update_interval; }
+        virtual uint32_t get_update_interval() const { return this->update_interval_; }
+
+        void start_poller();
+        void stop_poller();
+
+    protected:
+        uint32_t update_interval_;
+    };
+}
@@ -0,0 +1,27 @@
+// Host stand-in for esphome/core/hal.h. Time is simulated so runs on the host
+// are deterministic; tools move the clock forward with host::advance().
+#pragma once
+
+#include <cstdint>
+
+namespace esphome
+{
+    uint32_t millis();
+    uint32_t micros();
+    void delay(uint32_t ms);
+    void delayMicroseconds(uint32_t us);
+
+    // a real, free running counter so code can be timed on the host; it
+    // counts nanoseconds, independent of the simulated clock
+    uint32_t arch_get_cpu_cycle_count();
+    uint32_t arch_get_cpu_freq_hz();
+
+    namespace host
+    {
+        // moves the simulated clock forward
+        void advance_micros(uint64_t us);
+        inline void advance(uint32_t ms) { advance_micros(uint64_t(ms) * 1000); }
+        // microseconds since the simulated boot
+        uint64_t now_micros();
+    }
+}
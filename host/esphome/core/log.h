@@ -0,0 +1,75 @@
+// Host stand-in for esphome/core/log.h. Like the real macros, ESP_LOGx expand
+// to a call starting with an unqualified function name, so both ESP_LOGI(...)
+// and esphome::ESP_LOGI(...) work.
+#pragma once
+
+#include <cstdarg>
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+
+#ifndef ESPHOME_LOG_LEVEL
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_VERY_VERBOSE
+#endif
+
+namespace esphome
+{
+    void esp_log_printf_(int level, const char *tag, int line, const char *format, ...)
+        __attribute__((format(printf, 4, 5)));
+    // target of the macros that are compiled out, keeps esphome::ESP_LOGx(...) valid
+    inline void esp_log_none_(const char *, ...) {}
+
+    namespace host
+    {
+        // messages above this level are dropped before they are formatted,
+        // the default is ESPHOME_LOG_LEVEL_WARN so benchmarks stay quiet
+        void set_log_level(int level);
+        // number of messages that were formatted and printed
+        unsigned log_count();
+    }
+}
+
+#define esph_log_(level, tag, format, ...) esp_log_printf_(level, tag, __LINE__, format, ##__VA_ARGS__)
+#define esph_log_none_(tag, ...) esp_log_none_(tag, __VA_ARGS__)
+
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_ERROR
+#define ESP_LOGE(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#else
+#define ESP_LOGE(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_WARN
+#define ESP_LOGW(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#else
+#define ESP_LOGW(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_INFO
+#define ESP_LOGI(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#else
+#define ESP_LOGI(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_CONFIG
+#define ESP_LOGCONFIG(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_CONFIG, tag, __VA_ARGS__)
+#else
+#define ESP_LOGCONFIG(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+#define ESP_LOGD(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#else
+#define ESP_LOGD(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE
+#define ESP_LOGV(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_VERBOSE, tag, __VA_ARGS__)
+#else
+#define ESP_LOGV(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERY_VERBOSE
+#define ESP_LOGVV(tag, ...) esph_log_(ESPHOME_LOG_LEVEL_VERY_VERBOSE, tag, __VA_ARGS__)
+#else
+#define ESP_LOGVV(tag, ...) esph_log_none_(tag, __VA_ARGS__)
+#endif
@@ -0,0 +1,12 @@
+// Host stand-in for esphome/core/optional.h
+#pragma once
+
+#include <optional>
+
+namespace esphome
+{
+    template <typename T>
+    using optional = std::optional<T>;
+    using nullopt_t = std::nullopt_t;
+    inline constexpr nullopt_t nullopt = std::nullopt;
+}
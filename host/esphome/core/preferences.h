@@ -0,0 +1,64 @@
+// Host stand-in for esphome/core/preferences.h, backed by memory
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome
+{
+    class ESPPreferenceBackend
+    {
+    public:
+        virtual ~ESPPreferenceBackend() = default;
+        virtual bool save(const uint8_t *data, size_t len) = 0;
+        virtual bool load(uint8_t *data, size_t len) = 0;
+    };
+
+    class ESPPreferenceObject
+    {
+    public:
+        ESPPreferenceObject() = default;
+        explicit ESPPreferenceObject(ESPPreferenceBackend *backend) : backend_(backend) {}
+
+        template <typename T>
+        bool save(const T *src)
+        {
+            if (this->backend_ == nullptr)
+                return false;
+            return this->backend_->save(reinterpret_cast<const uint8_t *>(src), sizeof(T));
+        }
+
+        template <typename T>
+        bool load(T *dest)
+        {
+            if (this->backend_ == nullptr)
+                return false;
+            return this->backend_->load(reinterpret_cast<uint8_t *>(dest), sizeof(T));
+        }
+
+    protected:
+        ESPPreferenceBackend *backend_{nullptr};
+    };
+
+    class ESPPreferences
+    {
+    public:
+        virtual ~ESPPreferences() = default;
+        virtual ESPPreferenceObject make_preference(size_t length, uint32_t type, bool in_flash) = 0;
+        virtual bool sync() = 0;
+
+        template <typename T>
+        ESPPreferenceObject make_preference(uint32_t type, bool in_flash = false)
+        {
+            return this->make_preference(sizeof(T), type, in_flash);
+        }
+
+        // number of save() calls that reached the backend, i.e. flash writes on a device
+        uint32_t write_count() const { return this->write_count_; }
+
+    protected:
+        uint32_t write_count_{0};
+    };
+
+    extern ESPPreferences *global_preferences;
+}
@@ -0,0 +1,293 @@
+// Implementation of the host stand-ins for the ESPHome core. None of this is
+// compiled for a device; it only exists so include/ can run on Linux.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/components/sensor/filter.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+
+namespace esphome
+{
+    // --- clock ---------------------------------------------------------------
+
+    static uint64_t now_us = 0;
+
+    uint32_t millis() { return uint32_t(now_us / 1000); }
+    uint32_t micros() { return uint32_t(now_us); }
+    void delay(uint32_t ms) { now_us += uint64_t(ms) * 1000; }
+    void delayMicroseconds(uint32_t us) { now_us += us; }
+
+    uint32_t arch_get_cpu_cycle_count()
+    {
+        return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count());
+    }
+    uint32_t arch_get_cpu_freq_hz() { return 1000000000; }
+
+    namespace host
+    {
+        void advance_micros(uint64_t us) { now_us += us; }
+        uint64_t now_micros() { return now_us; }
+    }
+
+    // --- logger --------------------------------------------------------------
+
+    static int log_level = ESPHOME_LOG_LEVEL_WARN;
+    static unsigned log_count = 0;
+
+    namespace host
+    {
+        void set_log_level(int level) { log_level = level; }
+        unsigned log_count() { return ::esphome::log_count; }
+    }
+
+    void esp_log_printf_(int level, const char *tag, int line, const char *format, ...)
+    {
+        if (level > log_level)
+            return;
+
+        static const char LETTERS[] = " EWICDVV";
+        char message[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        log_count++;
+        fprintf(stderr, "[%c][%s:%03d]: %s\n", LETTERS[level & 7], tag, line, message);
+    }
+
+    // --- components and scheduler --------------------------------------------
+
+    namespace setup_priority
+    {
+        const float BUS = 1000.0f;
+        const float IO = 900.0f;
+        const float HARDWARE = 800.0f;
+        const float DATA = 600.0f;
+        const float PROCESSOR = 400.0f;
+        const float AFTER_WIFI = 200.0f;
+        const float AFTER_CONNECTION = 100.0f;
+        const float LATE = -100.0f;
+    }
+
+    Application App;
+
+    void Component::set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f)
+    {
+        App.schedule(this, name, interval, true, std::move(f));
+    }
+
+    bool Component::cancel_interval(const std::string &name) { return App.cancel(this, name, true); }
+
+    void Component::set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f)
+    {
+        App.schedule(this, name, timeout, false, std::move(f));
+    }
+
+    bool Component::cancel_timeout(const std::string &name) { return App.cancel(this, name, false); }
+
+    void PollingComponent::call_setup()
+    {
+        this->setup();
+        this->start_poller();
+    }
+
+    void PollingComponent::start_poller()
+    {
+        this->set_interval("update", this->get_update_interval(), [this]()
+                           { this->update(); });
+    }
+
+    void PollingComponent::stop_poller() { this->cancel_interval("update"); }
+
+    void Application::setup()
+    {
+        std::stable_sort(this->components_.begin(), this->components_.end(), [](Component *a, Component *b)
+                         { return a->get_setup_priority() > b->get_setup_priority(); });
+        for (size_t i = 0; i < this->components_.size(); i++)
+            this->components_[i]->call_setup();
+    }
+
+    void Application::schedule(Component *component, const std::string &name, uint32_t delay, bool repeat,
+                               std::function<void()> &&f)
+    {
+        if (!name.empty())
+            this->cancel(component, name, repeat);
+        if (delay == SCHEDULER_DONT_RUN)
+            return;
+        this->items_.push_back({component, name, now_us + uint64_t(delay) * 1000, delay, repeat, false, std::move(f)});
+    }
+
+    bool Application::cancel(Component *component, const std::string &name, bool repeat)
+    {
+        bool found = false;
+        for (auto &item : this->items_)
+            if (!item.removed && item.component == component && item.repeat == repeat && item.name == name)
+            {
+                item.removed = true;
+                found = true;
+            }
+        return found;
+    }
+
+    void Application::loop()
+    {
+        for (auto *component : this->components_)
+            component->loop();
+
+        // run due items in time order; callbacks may schedule or cancel items,
+        // so the vector is searched again after every call
+        while (true)
+        {
+            Item *due = nullptr;
+            for (auto &item : this->items_)
+                if (!item.removed && item.next_us <= now_us && (due == nullptr || item.next_us < due->next_us))
+                    due = &item;
+            if (due == nullptr)
+                break;
+
+            std::function<void()> f = due->f;
+            if (due->repeat)
+                due->next_us += std::max<uint64_t>(uint64_t(due->interval) * 1000, 1);
+            else
+                due->removed = true;
+            f();
+        }
+
+        this->items_.erase(std::remove_if(this->items_.begin(), this->items_.end(), [](const Item &item)
+                                          { return item.removed; }),
+                           this->items_.end());
+    }
+
+    void Application::run_for(uint32_t ms)
+    {
+        const uint64_t end = now_us + uint64_t(ms) * 1000;
+        this->loop();
+        while (true)
+        {
+            uint64_t next = end;
+            for (auto &item : this->items_)
+                if (!item.removed && item.next_us < next)
+                    next = item.next_us;
+            now_us = next;
+            this->loop();
+            if (next >= end)
+                break;
+        }
+    }
+
+    void Application::reset()
+    {
+        this->components_.clear();
+        this->items_.clear();
+    }
+
+    // --- preferences ---------------------------------------------------------
+
+    class HostPreferenceBackend : public ESPPreferenceBackend
+    {
+    public:
+        HostPreferenceBackend(std::vector<uint8_t> *storage, uint32_t *writes) : storage_(storage), writes_(writes) {}
+
+        bool save(const uint8_t *data, size_t len) override
+        {
+            this->storage_->assign(data, data + len);
+            (*this->writes_)++;
+            return true;
+        }
+
+        bool load(uint8_t *data, size_t len) override
+        {
+            if (this->storage_->size() != len)
+                return false;
+            std::copy(this->storage_->begin(), this->storage_->end(), data);
+            return true;
+        }
+
+    protected:
+        std::vector<uint8_t> *storage_;
+        uint32_t *writes_;
+    };
+
+    class HostPreferences : public ESPPreferences
+    {
+    public:
+        ESPPreferenceObject make_preference(size_t length, uint32_t type, bool in_flash) override
+        {
+            (void)length;
+            (void)in_flash;
+            auto &slot = this->slots_[type];
+            if (slot.backend == nullptr)
+                slot.backend = new HostPreferenceBackend(&slot.data, &this->write_count_);
+            return ESPPreferenceObject(slot.backend);
+        }
+
+        bool sync() override { return true; }
+
+    protected:
+        struct Slot
+        {
+            std::vector<uint8_t> data;
+            HostPreferenceBackend *backend{nullptr};
+        };
+        std::map<uint32_t, Slot> slots_;
+    };
+
+    static HostPreferences host_preferences;
+    ESPPreferences *global_preferences = &host_preferences;
+
+    // --- sensors -------------------------------------------------------------
+
+    static uint32_t next_object_id_hash = 0x1000;
+
+    EntityBase::EntityBase() : object_id_hash_(next_object_id_hash++) {}
+
+    namespace sensor
+    {
+        void Sensor::publish_state(float state)
+        {
+            this->raw_state = state;
+            for (auto &callback : this->raw_callbacks_)
+                callback(state);
+            this->state = state;
+            this->has_state_ = true;
+            this->publish_count_++;
+            for (auto &callback : this->callbacks_)
+                callback(state);
+        }
+
+        optional<float> ClampFilter::new_value(float value)
+        {
+            if (std::isfinite(value))
+            {
+                if (value < this->min_)
+                    return this->ignore_out_of_range_ ? optional<float>() : optional<float>(this->min_);
+                if (value > this->max_)
+                    return this->ignore_out_of_range_ ? optional<float>() : optional<float>(this->max_);
+            }
+            return value;
+        }
+
+        optional<float> CalibratePolynomialFilter::new_value(float value)
+        {
+            float res = 0.0f;
+            float x = 1.0f;
+            for (float coefficient : this->coefficients_)
+            {
+                res += x * coefficient;
+                x *= value;
+            }
+            return res;
+        }
+    }
+}
@@ -0,0 +1,300 @@
+/*
+  FixedMatrix.h - A matrix whose dimensions are template parameters.
+
+  The elements live inline in the object, so creating, copying or returning a
+  FixedMatrix never touches the heap. Every function is constexpr, which allows
+  small systems (such as the default pH calibration) to be solved by the
+  compiler.
+
+  The semantics follow Matrix.h: a calculation that can not be performed (a
+  singular system) leads to an empty matrix, so one should check notEmpty()
+  after calculation.
+
+  Elements are accessed like Matrix, A[i][j]. A FixedMatrix can be built with
+  aggregate initialisation:
+
+      FixedMatrix<2, 2> A = {{{1, 2},
+                              {3, 4}}};
+
+  For N <= 3 inv() and solve() use the closed form adjugate expressions, which
+  are fully unrolled. Larger systems use Gauss-Jordan elimination with partial
+  pivoting over compile-time loop bounds.
+
+  Use Matrix when the dimensions are only known at runtime.
+*/
+#pragma once
+
+template <int R, int C>
+struct FixedMatrix
+{
+    static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+    float _entity[R][C];
+    // false when the matrix is the result of an impossible calculation
+    bool _valid = true;
+
+    static constexpr int rows() { return R; }
+    static constexpr int columns() { return C; }
+
+    constexpr float *operator[](int index) { return _entity[index]; }
+    constexpr const float *operator[](int index) const { return _entity[index]; }
+
+    // check if it's an empty matrix.
+    constexpr bool notEmpty() const { return _valid; }
+
+    // ini stands for the initial value of all elements
+    static constexpr FixedMatrix filled(float ini)
+    {
+        FixedMatrix tmp{};
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                tmp._entity[i][j] = ini;
+        return tmp;
+    }
+
+    static constexpr FixedMatrix identity()
+    {
+        static_assert(R == C, "identity matrix has to be square");
+        FixedMatrix tmp{};
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                tmp._entity[i][j] = (i == j ? 1 : 0);
+        return tmp;
+    }
+
+    static constexpr FixedMatrix empty()
+    {
+        FixedMatrix tmp{};
+        tmp._valid = false;
+        return tmp;
+    }
+
+    constexpr FixedMatrix &operator+=(const FixedMatrix &A)
+    {
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                _entity[i][j] += A._entity[i][j];
+        _valid = _valid && A._valid;
+        return *this;
+    }
+
+    constexpr FixedMatrix &operator-=(const FixedMatrix &A)
+    {
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                _entity[i][j] -= A._entity[i][j];
+        _valid = _valid && A._valid;
+        return *this;
+    }
+
+    constexpr FixedMatrix &operator*=(float a)
+    {
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                _entity[i][j] *= a;
+        return *this;
+    }
+
+    constexpr FixedMatrix &operator/=(float a)
+    {
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                _entity[i][j] /= a;
+        return *this;
+    }
+
+    constexpr bool operator==(const FixedMatrix &A) const
+    {
+        if (_valid != A._valid)
+            return false;
+        for (int i = 0; i < R; i++)
+            for (int j = 0; j < C; j++)
+                if (_entity[i][j] != A._entity[i][j])
+                    return false;
+        return true;
+    }
+
+    constexpr bool operator!=(const FixedMatrix &A) const { return !(*this == A); }
+
+    // i: the row needs to be swaped, j: the position the row i goes to
+    constexpr void swapRow(int i, int j)
+    {
+        for (int k = 0; k < C; k++)
+        {
+            float tmp = _entity[i][k];
+            _entity[i][k] = _entity[j][k];
+            _entity[j][k] = tmp;
+        }
+    }
+};
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator+(FixedMatrix<R, C> A, const FixedMatrix<R, C> &B)
+{
+    return A += B;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator-(FixedMatrix<R, C> A, const FixedMatrix<R, C> &B)
+{
+    return A -= B;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator*(FixedMatrix<R, C> A, float a)
+{
+    return A *= a;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator*(float a, FixedMatrix<R, C> A)
+{
+    return A *= a;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator/(FixedMatrix<R, C> A, float a)
+{
+    return A /= a;
+}
+
+template <int R, int K, int C>
+constexpr FixedMatrix<R, C> operator*(const FixedMatrix<R, K> &A, const FixedMatrix<K, C> &B)
+{
+    FixedMatrix<R, C> tmp{};
+    for (int i = 0; i < R; i++)
+        for (int k = 0; k < K; k++)
+        {
+            const float a = A._entity[i][k];
+            for (int j = 0; j < C; j++)
+                tmp._entity[i][j] += a * B._entity[k][j];
+        }
+    tmp._valid = A._valid && B._valid;
+    return tmp;
+}
+
+// The transpose function won't modify the original matrix and it returns
+// the transpose of matrix A
+template <int R, int C>
+constexpr FixedMatrix<C, R> transpose(const FixedMatrix<R, C> &A)
+{
+    FixedMatrix<C, R> tmp{};
+    for (int i = 0; i < R; i++)
+        for (int j = 0; j < C; j++)
+            tmp._entity[j][i] = A._entity[i][j];
+    tmp._valid = A._valid;
+    return tmp;
+}
+
+namespace fixed_matrix_detail
+{
+    constexpr float absolute(float a) { return a < 0 ? -a : a; }
+
+    constexpr FixedMatrix<1, 1> inverse(const FixedMatrix<1, 1> &A)
+    {
+        if (A._entity[0][0] == 0)
+            return FixedMatrix<1, 1>::empty();
+        return {{{1 / A._entity[0][0]}}};
+    }
+
+    constexpr FixedMatrix<2, 2> inverse(const FixedMatrix<2, 2> &A)
+    {
+        const float a = A._entity[0][0], b = A._entity[0][1];
+        const float c = A._entity[1][0], d = A._entity[1][1];
+        const float det = a * d - b * c;
+        if (det == 0)
+            return FixedMatrix<2, 2>::empty();
+        return {{{d / det, -b / det},
+                 {-c / det, a / det}}};
+    }
+
+    constexpr FixedMatrix<3, 3> inverse(const FixedMatrix<3, 3> &A)
+    {
+        const float a = A._entity[0][0], b = A._entity[0][1], c = A._entity[0][2];
+        const float d = A._entity[1][0], e = A._entity[1][1], f = A._entity[1][2];
+        const float g = A._entity[2][0], h = A._entity[2][1], i = A._entity[2][2];
+
+        // cofactors of the first row, reused for the determinant
+        const float A00 = e * i - f * h;
+        const float A01 = f * g - d * i;
+        const float A02 = d * h - e * g;
+        const float det = a * A00 + b * A01 + c * A02;
+        if (det == 0)
+            return FixedMatrix<3, 3>::empty();
+
+        return {{{A00 / det, (c * h - b * i) / det, (b * f - c * e) / det},
+                 {A01 / det, (a * i - c * g) / det, (c * d - a * f) / det},
+                 {A02 / det, (b * g - a * h) / det, (a * e - b * d) / det}}};
+    }
+
+    // Gauss-Jordan elimination with partial pivoting; A is reduced to the
+    // identity and the same operations are applied to B
+    template <int N, int C>
+    constexpr FixedMatrix<N, C> eliminate(FixedMatrix<N, N> A, FixedMatrix<N, C> B)
+    {
+        for (int pivot = 0; pivot < N; pivot++)
+        {
+            // find best row for pivot - row with largest value in the pivot column
+            int bestRow = pivot;
+            for (int r = pivot + 1; r < N; r++)
+                if (absolute(A._entity[r][pivot]) > absolute(A._entity[bestRow][pivot]))
+                    bestRow = r;
+
+            if (A._entity[bestRow][pivot] == 0)
+                return FixedMatrix<N, C>::empty();
+
+            A.swapRow(pivot, bestRow);
+            B.swapRow(pivot, bestRow);
+
+            const float p = A._entity[pivot][pivot];
+            for (int c = 0; c < N; c++)
+                A._entity[pivot][c] /= p;
+            for (int c = 0; c < C; c++)
+                B._entity[pivot][c] /= p;
+
+            for (int r = 0; r < N; r++)
+            {
+                if (r == pivot)
+                    continue;
+                const float f = A._entity[r][pivot];
+                for (int c = 0; c < N; c++)
+                    A._entity[r][c] -= f * A._entity[pivot][c];
+                for (int c = 0; c < C; c++)
+                    B._entity[r][c] -= f * B._entity[pivot][c];
+            }
+        }
+
+        return B;
+    }
+
+    template <int N>
+    constexpr FixedMatrix<N, N> inverse(const FixedMatrix<N, N> &A)
+    {
+        return eliminate(A, FixedMatrix<N, N>::identity());
+    }
+
+    template <int N, int C>
+    constexpr FixedMatrix<N, C> solve(const FixedMatrix<N, N> &A, const FixedMatrix<N, C> &v)
+    {
+        return N <= 3 ? inverse(A) * v : eliminate(A, v);
+    }
+}
+
+// The inverse function won't modify the original matrix and it returns the
+// inverse of matrix A, or an empty matrix when A is singular
+template <int N>
+constexpr FixedMatrix<N, N> inv(const FixedMatrix<N, N> &A)
+{
+    if (!A._valid)
+        return FixedMatrix<N, N>::empty();
+    return fixed_matrix_detail::inverse(A);
+}
+
+// Solve the matrix equation Ax = v for x; the result is empty when A is singular
+template <int N, int C>
+constexpr FixedMatrix<N, C> solveFor(const FixedMatrix<N, N> &A, const FixedMatrix<N, C> &v)
+{
+    if (!A._valid || !v._valid)
+        return FixedMatrix<N, C>::empty();
+    return fixed_matrix_detail::solve(A, v);
+}
@@ -1,5 +1,8 @@
 #include "Matrix.h"
+#include <cmath>
 #include <cstring>
+#include <new>
+#include <utility>
 
 // Solve the matrix equation Ax = v for x; where x, v are column vectors
 // will work on copies of A,v so originals are undisturbed
@@ -12,200 +15,338 @@ Matrix solveFor(Matrix A, Matrix v)
         return Matrix();
     }
 
-    for (int pivot = 0; pivot < A._row; pivot++)
+    // A and v are already copies, factor and solve in their storage
+    LUDecomposition lu(std::move(A));
+    if (!lu.solveInto(v, v))
+        return Matrix();
+    return v;
+}
+
+Matrix inv(const Matrix &A)
+{
+    return LUDecomposition(A).inverse();
+}
+
+LUDecomposition::LUDecomposition(Matrix A) : _lu(std::move(A)), _sign(1), _singular(false)
+{
+    const int n = _lu._row;
+    if (n <= 0 || _lu._column != n)
+    {
+        _singular = true;
+        return;
+    }
+
+    for (int k = 0; k < n; k++)
     {
-        // find best row for pivot - row with largest value in the pivot column
-        float maxPivot = 0;
-        int bestRow = -1;
-        for (int chkRow = pivot; chkRow < A._row; chkRow++)
+        // partial pivoting: the row with the largest magnitude in column k
+        int best = k;
+        float bestValue = fabsf(_lu[k][k]);
+        for (int i = k + 1; i < n; i++)
         {
-            if (A._entity[chkRow][pivot] > maxPivot)
-            {
-                bestRow = chkRow;
-                maxPivot = A._entity[chkRow][pivot];
-            }
-            else if (-A._entity[chkRow][pivot] > maxPivot)
+            const float value = fabsf(_lu[i][k]);
+            if (value > bestValue)
             {
-                bestRow = chkRow;
-                maxPivot = -A._entity[chkRow][pivot];
+                best = i;
+                bestValue = value;
             }
         }
 
-        if (bestRow == -1)
+        if (bestValue == 0)
         {
-            // throw Singular(); //error
-            return Matrix();
+            _singular = true;
+            return;
         }
 
-        if (bestRow != pivot)
+        if (best != k)
         {
-            A.swapRow(pivot, bestRow);
-            v.swapRow(pivot, bestRow);
+            _lu.swapRow(k, best);
+            _sign = -_sign;
         }
 
-        maxPivot = A._entity[pivot][pivot]; // get the sign back if was -ve
-        // we've got our pivot row - divide row by maxPivot to make pivot value 1
-        A._entity[pivot][pivot] = 1;
-        for (int c = pivot + 1; c < A._column; c++)
+        const float *pivotRow = _lu[k];
+        const float pivot = pivotRow[k];
+        for (int i = k + 1; i < n; i++)
         {
-            A._entity[pivot][c] /= maxPivot;
-        }
-        // and do same in vector
-        v._entity[pivot][0] /= maxPivot;
-
-        // we'll go full Gaussian on this - as it saves some coding
-        // TODO could be more efficient?
-        for (int r = 0; r < A._row;
-             r++)
-        { // full gaussian so do all rows but our own
-            if (r != pivot)
-            {
-                float f = A._entity[r][pivot];
-                A._entity[r][pivot] = 0;
-                for (int c = pivot + 1; c < A._column; c++)
-                {
-                    A._entity[r][c] -= f * A._entity[pivot][c];
-                }
-                v._entity[r][0] -= f * v._entity[pivot][0];
-            }
+            float *row = _lu[i];
+            const float f = row[k] / pivot;
+            row[k] = f;
+            for (int j = k + 1; j < n; j++)
+                row[j] -= f * pivotRow[j];
         }
     }
-
-    return v;
 }
 
-Matrix inv(const Matrix &A)
+bool LUDecomposition::solveInto(const Matrix &b, Matrix &x) const
 {
-    // has to be a square matrix
-    if (A._row != A._column)
-    {
-        // esphome::ESP_LOGI("Inv Has to be a square matrix");
-    }
-
-    Matrix tmp(A._row, A._column, 'I');
-    Matrix copy(A);
+    const int n = _lu._row;
+    if (_singular || b._row != n || x._row != n || x._column != b._column)
+        return false;
 
-    // set the pivot to be the largest element in that column
-    for (int i = 0; i < A._row - 1; i++)
+    const int columns = b._column;
+    // the factors' row order is the pivot order, _perm maps it back to rows of b
+    if (&x == &b)
     {
-        float pivot = copy._entity[i][i];
-        int row = i;
-        for (int j = i + 1; j < A._row; j++)
-            if (copy._entity[j][i] > pivot)
+        // x[i] has to become the current x[_perm[i]]; permute x's row index
+        // table cycle by cycle, starting each cycle only at its smallest index
+        int *table = x._perm;
+        const int *p = _lu._perm;
+        for (int start = 0; start < n; start++)
+        {
+            int i = p[start];
+            while (i > start)
+                i = p[i];
+            if (i < start)
+                continue;
+
+            const int first = table[start];
+            int j = start;
+            for (i = p[start]; i != start; i = p[i])
             {
-                pivot = copy._entity[j][i];
-                row = j;
+                table[j] = table[i];
+                j = i;
             }
-
-        if (pivot == 0)
-        {
-            return Matrix();
+            table[j] = first;
         }
-        else
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
         {
-            copy.swapRow(i, row);
-            tmp.swapRow(i, row);
+            const float *source = b[_lu._perm[i]];
+            float *out = x[i];
+            for (int c = 0; c < columns; c++)
+                out[c] = source[c];
         }
     }
 
-    for (int i = 0; i < A._row; i++)
-        for (int j = 0; j < A._row; j++)
-            if (i != j)
-            {
-                float backup = copy._entity[j][i];
-                for (int k = 0; k < A._column; k++)
-                {
-                    copy._entity[j][k] -= backup * copy._entity[i][k] / copy._entity[i][i];
-                    tmp._entity[j][k] -= backup * tmp._entity[i][k] / copy._entity[i][i];
-                }
-            }
+    // forward substitution with the unit lower triangle
+    for (int i = 1; i < n; i++)
+    {
+        const float *row = _lu[i];
+        float *out = x[i];
+        for (int k = 0; k < i; k++)
+        {
+            const float *xk = x[k];
+            for (int c = 0; c < columns; c++)
+                out[c] -= row[k] * xk[c];
+        }
+    }
 
-    for (int i = 0; i < A._row; i++)
-        for (int j = 0; j < A._column; j++)
+    // back substitution with the upper triangle
+    for (int i = n - 1; i >= 0; i--)
+    {
+        const float *row = _lu[i];
+        float *out = x[i];
+        for (int k = i + 1; k < n; k++)
         {
-            tmp._entity[i][j] /= copy._entity[i][i];
+            const float *xk = x[k];
+            for (int c = 0; c < columns; c++)
+                out[c] -= row[k] * xk[c];
         }
+        for (int c = 0; c < columns; c++)
+            out[c] /= row[i];
+    }
 
-    return tmp;
+    return true;
+}
+
+Matrix LUDecomposition::solve(const Matrix &b) const
+{
+    Matrix x(b._row, b._column);
+    if (!solveInto(b, x))
+        return Matrix();
+    return x;
+}
+
+float LUDecomposition::determinant() const
+{
+    if (_singular)
+        return 0;
+
+    float det = _sign;
+    for (int i = 0; i < _lu._row; i++)
+        det *= _lu[i][i];
+    return det;
+}
+
+Matrix LUDecomposition::inverse() const
+{
+    if (_singular)
+        return Matrix();
+    return solve(Matrix(_lu._row, _lu._column, 'I'));
 }
 
 Matrix transpose(const Matrix &A)
 {
     Matrix tmp(A._column, A._row);
+    if (tmp._perm == nullptr)
+        return tmp;
 
     for (int i = 0; i < A._row; i++)
+    {
+        const float *row = A[i];
         for (int j = 0; j < A._column; j++)
-            tmp._entity[j][i] = A._entity[i][j];
+            tmp[j][i] = row[j];
+    }
 
     return tmp;
 }
 
+static MatrixArena *currentArena = nullptr;
+
+MatrixArena::MatrixArena(void *buffer, size_t capacity)
+    : _buffer(static_cast<unsigned char *>(buffer)), _capacity(capacity), _used(0), _highWater(0), _failures(0)
+{
+}
+
+void *MatrixArena::allocate(size_t bytes)
+{
+    // blocks start 8 byte aligned, enough for the int and float parts
+    const size_t start = (_used + 7) & ~(size_t)7;
+    if (start > _capacity || bytes > _capacity - start)
+    {
+        _failures++;
+        return nullptr;
+    }
+    _used = start + bytes;
+    if (_used > _highWater)
+        _highWater = _used;
+    return _buffer + start;
+}
+
+void MatrixArena::rewind(size_t mark)
+{
+    if (mark < _used)
+        _used = mark;
+}
+
+MatrixArena *MatrixArena::current()
+{
+    return currentArena;
+}
+
+MatrixArenaScope::MatrixArenaScope(MatrixArena &arena) : _arena(arena), _previous(currentArena), _mark(arena.used())
+{
+    currentArena = &arena;
+}
+
+MatrixArenaScope::~MatrixArenaScope()
+{
+    _arena.rewind(_mark);
+    currentArena = _previous;
+}
+
+void Matrix::allocate(int r, int c)
+{
+    _row = r;
+    _column = c;
+    _stride = c;
+    _perm = nullptr;
+    _data = nullptr;
+    _arena = nullptr;
+    if (r <= 0 || c < 0)
+        return;
+
+    const size_t bytes = r * sizeof(int) + r * c * sizeof(float);
+    void *block;
+    if (currentArena != nullptr)
+    {
+        block = currentArena->allocate(bytes);
+        if (block == nullptr)
+        {
+            // a full arena fails the same way every time, it never falls back to the heap
+            _row = 0;
+            _column = 0;
+            _stride = 0;
+            return;
+        }
+        _arena = currentArena;
+    }
+    else
+    {
+        block = ::operator new(bytes);
+    }
+    _perm = static_cast<int *>(block);
+    _data = reinterpret_cast<float *>(_perm + r);
+    for (int i = 0; i < r; i++)
+        _perm[i] = i;
+}
+
+void Matrix::reshape(int r, int c)
+{
+    if (_perm != nullptr && _row == r && _column == c)
+        return;
+    release();
+    allocate(r, c);
+}
+
+void Matrix::release()
+{
+    // arena blocks are freed when their scope ends
+    if (_perm != nullptr && _arena == nullptr)
+        ::operator delete(_perm);
+    _perm = nullptr;
+    _data = nullptr;
+    _arena = nullptr;
+    _row = 0;
+    _column = 0;
+    _stride = 0;
+}
+
 Matrix::Matrix()
 {
     _row = 0;
     _column = 0;
-    _entity = nullptr;
+    _stride = 0;
+    _perm = nullptr;
+    _data = nullptr;
+    _arena = nullptr;
 }
 
 Matrix::Matrix(int r, int c, int ini)
 {
-    _row = r;
-    _column = c;
-    _entity = new float *[_row];
-    for (int i = 0; i < _row; i++)
-        _entity[i] = new float[_column];
+    allocate(r, c);
 
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-            _entity[i][j] = ini;
+    for (int i = 0; i < _row * _stride; i++)
+        _data[i] = ini;
 }
 
 Matrix::Matrix(const Matrix &m)
 {
-    _row = m._row;
-    _column = m._column;
-
-    _entity = new float *[_row];
-    for (int i = 0; i < _row; i++)
-        _entity[i] = new float[_column];
+    allocate(m._row, m._column);
 
     int bytes = _column * sizeof(float);
     for (int i = 0; i < _row; i++)
-        memcpy(_entity[i], m._entity[i], bytes);
+        memcpy(_data + i * _stride, m[i], bytes);
 }
 
 Matrix::Matrix(Matrix &&m)
 {
     _row = m._row;
     _column = m._column;
-    _entity = m._entity;
-    m._entity = nullptr;
+    _stride = m._stride;
+    _perm = m._perm;
+    _data = m._data;
+    _arena = m._arena;
+    m._perm = nullptr;
+    m._data = nullptr;
+    m._arena = nullptr;
     m._row = 0;
     m._column = 0;
+    m._stride = 0;
 }
 
 Matrix::Matrix(int r, int c, float *m)
 {
-    _row = r;
-    _column = c;
+    allocate(r, c);
 
-    _entity = new float *[_row];
-    for (int i = 0; i < r; i++)
-        _entity[i] = new float[_column];
-
-    int bytes = _column * sizeof(float);
-    for (int i = 0; i < _row; i++)
-        memcpy(_entity[i], m + i * _column, bytes);
+    if (_data != nullptr)
+        memcpy(_data, m, _row * _column * sizeof(float));
 }
 
 Matrix::Matrix(int r, int c, char type)
 {
-    _row = r;
-    _column = c;
-
-    _entity = new float *[_row];
-    for (int i = 0; i < r; i++)
-        _entity[i] = new float[_column];
+    allocate(r, c);
 
     switch (type)
     {
@@ -214,229 +355,209 @@ Matrix::Matrix(int r, int c, char type)
         {
             for (int i = 0; i < _row; i++)
                 for (int j = 0; j < _column; j++)
-                    _entity[i][j] = (i == j ? 1 : 0);
+                    _data[i * _stride + j] = (i == j ? 1 : 0);
         }
         else
         {
-            if (_entity != nullptr)
-            {
-                for (int i = 0; i < _row; i++)
-                    delete[] _entity[i];
-                delete[] _entity;
-            }
+            release();
         }
         break;
     default:
-        for (int i = 0; i < _row; i++)
-            for (int j = 0; j < _column; j++)
-                _entity[i][j] = 0;
+        for (int i = 0; i < _row * _stride; i++)
+            _data[i] = 0;
     }
 }
 
 Matrix::~Matrix()
 {
-    if (_entity != nullptr)
-    {
-        for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-        delete[] _entity;
-    }
+    release();
 }
 
-Matrix Matrix::operator*(const Matrix &A)
+// C = A B, C has the product's shape and is neither A nor B. Tiles of B are
+// swept row by row (i-k-j), so the innermost loop runs over contiguous
+// elements of B and C; every element still sums its terms in order of k.
+static void multiplyBlocked(Matrix &C, const Matrix &A, const Matrix &B)
 {
-    // if (_column != A._row)
-    //     esphome::ESP_LOGI("Multiplication matrix dimension not match");
-
-    Matrix tmp(_row, A._column);
+    const int n = A._row, m = A._column, p = B._column;
+    // C could not be given the product's shape, its arena is full
+    if (C._row != n || C._column != p)
+        return;
+    for (int i = 0; i < n; i++)
+    {
+        float *out = C[i];
+        for (int j = 0; j < p; j++)
+            out[j] = 0;
+    }
 
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < A._column; j++)
+    for (int kk = 0; kk < m; kk += MATRIX_BLOCK)
+    {
+        const int kEnd = kk + MATRIX_BLOCK < m ? kk + MATRIX_BLOCK : m;
+        for (int jj = 0; jj < p; jj += MATRIX_BLOCK)
         {
-            for (int k = 0; k < _column; k++)
-                tmp._entity[i][j] += _entity[i][k] * A._entity[k][j];
+            const int jEnd = jj + MATRIX_BLOCK < p ? jj + MATRIX_BLOCK : p;
+            for (int i = 0; i < n; i++)
+            {
+                const float *row = A[i];
+                float *out = C[i];
+                for (int k = kk; k < kEnd; k++)
+                {
+                    const float a = row[k];
+                    const float *other = B[k];
+                    for (int j = jj; j < jEnd; j++)
+                        out[j] += a * other[j];
+                }
+            }
         }
+    }
+}
 
-    return tmp;
+void Matrix::evaluate(const MatrixProduct<Matrix, Matrix> &e)
+{
+    multiplyBlocked(*this, e.left(), e.right());
 }
 
-Matrix &Matrix::operator*=(const Matrix &A)
+bool multiply(Matrix &dst, const Matrix &A, const Matrix &B, Matrix &workspace)
 {
-    // check if the dimension matches
-    if (_column != A._row)
+    if (A._column != B._row || A._row <= 0 || B._column <= 0)
     {
-        if (_entity != nullptr)
-        {
-            for (int i = 0; i < _row; i++)
-                delete[] _entity[i];
-            delete[] _entity;
-        }
-        return *this;
+        dst.release();
+        return false;
     }
 
-    Matrix tmp(*this);
-
-    // the dimension of the result matrix does not match the calling matrix
-    if (_column != A._column)
+    if (&dst != &A && &dst != &B)
     {
-        for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-
-        _column = A._column;
-
-        for (int i = 0; i < _row; i++)
-            _entity[i] = new float[_column];
-
-        for (int i = 0; i < _row; i++)
-            for (int j = 0; j < _column; j++)
-            {
-                _entity[i][j] = 0;
-                for (int k = 0; k < tmp._column; k++)
-                    _entity[i][j] += tmp._entity[i][k] * A._entity[k][j];
-            }
+        dst.reshape(A._row, B._column);
+        multiplyBlocked(dst, A, B);
+        return dst._perm != nullptr;
     }
-    else
-    { // the dimension of the result matrix matches the calling matrix
-        for (int i = 0; i < _row; i++)
-            for (int j = 0; j < _column; j++)
-            {
-                _entity[i][j] = 0;
-                for (int k = 0; k < _column; k++)
-                    _entity[i][j] += tmp._entity[i][k] * A._entity[k][j];
-            }
+
+    if (&workspace == &A || &workspace == &B)
+    {
+        // no storage to spare, the product takes a fresh block
+        Matrix tmp(A._row, B._column);
+        multiplyBlocked(tmp, A, B);
+        dst = std::move(tmp);
+        return dst._perm != nullptr;
     }
 
-    return *this;
+    workspace.reshape(A._row, B._column);
+    if (workspace._perm == nullptr)
+    {
+        dst.release();
+        return false;
+    }
+    multiplyBlocked(workspace, A, B);
+    std::swap(dst._row, workspace._row);
+    std::swap(dst._column, workspace._column);
+    std::swap(dst._stride, workspace._stride);
+    std::swap(dst._perm, workspace._perm);
+    std::swap(dst._data, workspace._data);
+    std::swap(dst._arena, workspace._arena);
+    return true;
 }
 
-Matrix Matrix::operator*(float a)
+Matrix &Matrix::operator*=(const Matrix &A)
 {
-    Matrix tmp(_row, _column);
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-        {
-            tmp._entity[i][j] = _entity[i][j] * a;
-        }
+    // check if the dimension matches
+    if (_column != A._row)
+    {
+        release();
+        return *this;
+    }
 
-    return tmp;
-}
+    if (&A == this || A._row != A._column || A._column > MATRIX_ROW_BUFFER)
+    {
+        // the product is built in fresh storage, so the operands are never
+        // overwritten while they are still being read
+        Matrix tmp(_row, A._column);
+        multiplyBlocked(tmp, *this, A);
+        *this = std::move(tmp);
+        return *this;
+    }
 
-Matrix &Matrix::operator*=(float a)
-{
+    // A is square, row i of the product only depends on row i of this matrix
+    float buffer[MATRIX_ROW_BUFFER];
     for (int i = 0; i < _row; i++)
+    {
+        float *row = (*this)[i];
         for (int j = 0; j < _column; j++)
+            buffer[j] = 0;
+        for (int k = 0; k < _column; k++)
         {
-            _entity[i][j] *= a;
+            const float a = row[k];
+            const float *other = A[k];
+            for (int j = 0; j < _column; j++)
+                buffer[j] += a * other[j];
         }
+        memcpy(row, buffer, _column * sizeof(float));
+    }
 
     return *this;
 }
 
-template <class G>
-Matrix operator*(G a, const Matrix &A)
-{
-    return A * a;
-}
-
-Matrix Matrix::operator/(float a)
+Matrix &Matrix::operator*=(float a)
 {
-    Matrix tmp(_row, _column);
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-        {
-            tmp._entity[i][j] = _entity[i][j] / a;
-        }
+    for (int i = 0; i < _row * _stride; i++)
+    {
+        _data[i] *= a;
+    }
 
-    return tmp;
+    return *this;
 }
 
 Matrix &Matrix::operator/=(float a)
 {
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-        {
-            _entity[i][j] /= a;
-        }
+    for (int i = 0; i < _row * _stride; i++)
+    {
+        _data[i] /= a;
+    }
 
     return *this;
 }
 
-Matrix Matrix::operator+(const Matrix &A)
-{
-    // if (_row != A._row || _column != A._column)
-    //     esphome::ESP_LOGI("Plus matrix dimension not match");
-
-    Matrix tmp(_row, _column);
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-        {
-            tmp._entity[i][j] = _entity[i][j] + A._entity[i][j];
-        }
-
-    return tmp;
-}
-
 float Matrix::operator+(float a)
 {
     // if (_row != 1 || _column != 1)
     //     esphome::ESP_LOGI("Plus scalar dimension not match");
 
-    return _entity[0][0] + a;
+    return (*this)[0][0] + a;
 }
 
-template <class T>
-T operator+(T a, const Matrix &A)
+float operator+(float a, const Matrix &A)
 {
     // if (A._row != 1 || A._column != 1)
     //     esphome::ESP_LOGI("Plus scalar dimension not match");
 
-    return a + A._entity[0][0];
+    return a + A[0][0];
 }
 
 Matrix &Matrix::operator+=(const Matrix &A)
 {
     if (_row != A._row || _column != A._column)
     {
-        for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-        delete[] _entity;
+        release();
         return *this;
     }
 
     for (int i = 0; i < _row; i++)
+    {
+        float *row = (*this)[i];
+        const float *other = A[i];
         for (int j = 0; j < _column; j++)
         {
-            _entity[i][j] = _entity[i][j] + A._entity[i][j];
+            row[j] = row[j] + other[j];
         }
+    }
 
     return *this;
 }
 
-Matrix Matrix::operator-(const Matrix &A)
-{
-    // if (_row != A._row || _column != A._column)
-    //     esphome::ESP_LOGI("Sub scalar dimension not match");
-
-    Matrix tmp(_row, _column);
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-        {
-            tmp._entity[i][j] = _entity[i][j] - A._entity[i][j];
-        }
-
-    return tmp;
-}
-
 float Matrix::operator-(float a)
 {
     // if (_row != 1 || _column != 1)
     //     esphome::ESP_LOGI("Sub scalar dimension not match");
 
-    return _entity[0][0] - a;
+    return (*this)[0][0] - a;
 }
 
 float operator-(float a, const Matrix &A)
@@ -444,84 +565,88 @@ float operator-(float a, const Matrix &A)
     // if (A._row != 1 || A._column != 1)
     //     esphome::ESP_LOGI("Sub scalar dimension not match");
 
-    return a - A._entity[0][0];
+    return a - A[0][0];
 }
 
 Matrix &Matrix::operator-=(const Matrix &A)
 {
     if (_row != A._row || _column != A._column)
     {
-        for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-        delete[] _entity;
+        release();
         return *this;
     }
 
     for (int i = 0; i < _row; i++)
+    {
+        float *row = (*this)[i];
+        const float *other = A[i];
         for (int j = 0; j < _column; j++)
         {
-            _entity[i][j] = _entity[i][j] - A._entity[i][j];
+            row[j] = row[j] - other[j];
         }
+    }
 
     return *this;
 }
 
 float *Matrix::operator[](int index)
 {
-    return _entity[index];
+    return _data + _perm[index] * _stride;
+}
+
+const float *Matrix::operator[](int index) const
+{
+    return _data + _perm[index] * _stride;
 }
 
 Matrix &Matrix::operator=(const Matrix &A)
 {
-    if (_entity != nullptr)
+    if (this == &A)
+        return *this;
+
+    // the existing block can be reused when the shape is unchanged
+    if (_perm == nullptr || _row != A._row || _column != A._column)
+    {
+        release();
+        allocate(A._row, A._column);
+    }
+    else
     {
         for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-        delete[] _entity;
+            _perm[i] = i;
     }
 
-    _row = A._row;
-    _column = A._column;
-
-    _entity = new float *[_row];
+    int bytes = _column * sizeof(float);
     for (int i = 0; i < _row; i++)
-        _entity[i] = new float[_column];
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-            _entity[i][j] = A._entity[i][j];
+        memcpy(_data + i * _stride, A[i], bytes);
 
     return *this;
 }
 
 Matrix &Matrix::operator=(Matrix &&A)
 {
-    if (_entity != nullptr)
-    {
-        for (int i = 0; i < _row; i++)
-            delete[] _entity[i];
-        delete[] _entity;
-    }
+    if (this == &A)
+        return *this;
+
+    release();
     _row = A._row;
     _column = A._column;
-    _entity = A._entity;
-    A._entity = nullptr;
+    _stride = A._stride;
+    _perm = A._perm;
+    _data = A._data;
+    _arena = A._arena;
+    A._perm = nullptr;
+    A._data = nullptr;
+    A._arena = nullptr;
     A._row = 0;
     A._column = 0;
+    A._stride = 0;
     return *this;
 }
 
 bool Matrix::operator!=(const Matrix &A)
 {
-    if (_row != A._row || _column != A._column)
-        return true;
-
-    for (int i = 0; i < _row; i++)
-        for (int j = 0; j < _column; j++)
-            if (_entity[i][j] != A._entity[i][j])
-                return true;
-
-    return false;
+    return !(*this == A);
 }
 
 bool Matrix::operator==(const Matrix &A)
@@ -530,9 +655,13 @@ bool Matrix::operator==(const Matrix &A)
         return false;
 
     for (int i = 0; i < _row; i++)
+    {
+        const float *row = (*this)[i];
+        const float *other = A[i];
         for (int j = 0; j < _column; j++)
-            if (_entity[i][j] != A._entity[i][j])
+            if (row[j] != other[j])
                 return false;
+    }
 
     return true;
 }
@@ -541,13 +670,9 @@ void Matrix::swapRow(int i, int j)
 {
     if (i != j && i < _row && j < _row && i >= 0 && j >= 0)
     {
-        float tmp;
-        for (int k = 0; k < _column; k++)
-        {
-            tmp = _entity[j][k];
-            _entity[j][k] = _entity[i][k];
-            _entity[i][k] = tmp;
-        }
+        int tmp = _perm[j];
+        _perm[j] = _perm[i];
+        _perm[i] = tmp;
     }
 }
 
@@ -561,7 +686,7 @@ void Matrix::show(int decimal)
             for (int j = 0; j < _column; j++)
             {
                 // Serial.print("  ");
-                // Serial.print(_entity[i][j]);
+                // Serial.print((*this)[i][j]);
                 // Serial.print(" ");
             }
             // esphome::ESP_LOGI("]");
@@ -576,7 +701,7 @@ void Matrix::show(int decimal)
             for (int j = 0; j < _column; j++)
             {
                 // Serial.print("  ");
-                // Serial.print(_entity[i][j], decimal);
+                // Serial.print((*this)[i][j], decimal);
                 // Serial.print(" ");
             }
             // esphome::ESP_LOGI("]");
@@ -587,7 +712,194 @@ void Matrix::show(int decimal)
 
 bool Matrix::notEmpty()
 {
-    if (_entity == nullptr)
+    if (_data == nullptr)
         return false;
     return true;
-}
\ No newline at end of file
+}
+
+// Cholesky factorization of the symmetric n by n matrix G into L (lower
+// triangular, G = LL'), false when G is not positive definite
+static bool cholesky(const Matrix &G, Matrix &L)
+{
+    const int n = G._row;
+    for (int j = 0; j < n; j++)
+    {
+        float *Lj = L[j];
+        float d = G[j][j];
+        for (int k = 0; k < j; k++)
+            d -= Lj[k] * Lj[k];
+        if (!(d > 0))
+            return false;
+        d = sqrtf(d);
+        Lj[j] = d;
+        for (int k = j + 1; k < n; k++)
+            Lj[k] = 0;
+
+        for (int i = j + 1; i < n; i++)
+        {
+            float *Li = L[i];
+            float sum = G[i][j];
+            for (int k = 0; k < j; k++)
+                sum -= Li[k] * Lj[k];
+            Li[j] = sum / d;
+        }
+    }
+    return true;
+}
+
+// solves LL'x = b in place, b is n by 1
+static void choleskySolve(const Matrix &L, Matrix &x)
+{
+    const int n = L._row;
+    for (int i = 0; i < n; i++)
+    {
+        const float *Li = L[i];
+        float sum = x[i][0];
+        for (int k = 0; k < i; k++)
+            sum -= Li[k] * x[k][0];
+        x[i][0] = sum / Li[i];
+    }
+    for (int i = n - 1; i >= 0; i--)
+    {
+        float sum = x[i][0];
+        for (int k = i + 1; k < n; k++)
+            sum -= L[k][i] * x[k][0];
+        x[i][0] = sum / L[i][i];
+    }
+}
+
+static Matrix normalEquations(const Matrix &A, const Matrix &b, const Matrix *w)
+{
+    if (A._row < A._column || A._column <= 0 || b._row != A._row || b._column != 1 ||
+        (w != nullptr && (w->_row != A._row || w->_column != 1)))
+        return Matrix();
+
+    const int n = A._column;
+    LeastSquaresSolver solver(n);
+    for (int i = 0; i < A._row; i++)
+        solver.addRow(A[i], b[i][0], w == nullptr ? 1 : (*w)[i][0]);
+    return solver.solve();
+}
+
+Matrix leastSquares(const Matrix &A, const Matrix &b)
+{
+    return normalEquations(A, b, nullptr);
+}
+
+Matrix leastSquares(const Matrix &A, const Matrix &b, const Matrix &w)
+{
+    return normalEquations(A, b, &w);
+}
+
+LeastSquaresSolver::LeastSquaresSolver(int n)
+{
+    reset(n);
+}
+
+void LeastSquaresSolver::reset(int n)
+{
+    _n = n;
+    _rows = 0;
+    _factored = false;
+    if (_gram._row != n)
+    {
+        _gram = Matrix(n, n);
+        _rhs = Matrix(n, 1);
+        _factor = Matrix(n, n);
+        _work = Matrix(n, 1);
+        // out of arena space, the solver stays without unknowns
+        if (!_gram.notEmpty() || !_rhs.notEmpty() || !_factor.notEmpty() || !_work.notEmpty())
+            _n = 0;
+    }
+    else
+    {
+        _gram *= 0;
+        _rhs *= 0;
+    }
+}
+
+bool LeastSquaresSolver::updateFactor(float sign)
+{
+    for (int k = 0; k < _n; k++)
+    {
+        float *Lk = _factor[k];
+        const float xk = _work[k][0];
+        const float r2 = Lk[k] * Lk[k] + sign * xk * xk;
+        if (!(r2 > 0))
+            return false;
+        const float r = sqrtf(r2);
+        const float c = r / Lk[k];
+        const float s = xk / Lk[k];
+        Lk[k] = r;
+        for (int i = k + 1; i < _n; i++)
+        {
+            float *Li = _factor[i];
+            Li[k] = (Li[k] + sign * s * _work[i][0]) / c;
+            _work[i][0] = c * _work[i][0] - s * Li[k];
+        }
+    }
+    return true;
+}
+
+bool LeastSquaresSolver::factor()
+{
+    _factored = cholesky(_gram, _factor);
+    return _factored;
+}
+
+void LeastSquaresSolver::addRow(const float *a, float b, float w)
+{
+    for (int i = 0; i < _n; i++)
+    {
+        float *g = _gram[i];
+        for (int j = 0; j < _n; j++)
+            g[j] += w * a[i] * a[j];
+        _rhs[i][0] += w * a[i] * b;
+    }
+    _rows++;
+
+    if (_factored)
+    {
+        const float sw = sqrtf(w);
+        for (int i = 0; i < _n; i++)
+            _work[i][0] = sw * a[i];
+        if (!updateFactor(1))
+            _factored = false;
+    }
+}
+
+void LeastSquaresSolver::removeRow(const float *a, float b, float w)
+{
+    for (int i = 0; i < _n; i++)
+    {
+        float *g = _gram[i];
+        for (int j = 0; j < _n; j++)
+            g[j] -= w * a[i] * a[j];
+        _rhs[i][0] -= w * a[i] * b;
+    }
+    _rows--;
+
+    if (_factored)
+    {
+        const float sw = sqrtf(w);
+        for (int i = 0; i < _n; i++)
+            _work[i][0] = sw * a[i];
+        // a downdate that loses positive definiteness leaves a broken factor,
+        // solve() refactors from the normal equations in that case
+        if (!updateFactor(-1))
+            _factored = false;
+    }
+}
+
+Matrix LeastSquaresSolver::solve()
+{
+    if (_n <= 0 || _rows < _n)
+        return Matrix();
+    if (!_factored && !factor())
+        return Matrix();
+
+    Matrix x(_rhs);
+    if (x.notEmpty())
+        choleskySolve(_factor, x);
+    return x;
+}
@@ -20,6 +20,34 @@
 
   Feedback and contribution is welcome!
 
+  Version 1.9
+  * Matrices can draw their storage from a fixed capacity MatrixArena instead of the heap while a MatrixArenaScope
+    is open. The scope frees everything at once when it ends, and a request that does not fit gives an empty
+    matrix instead of falling back to the heap.
+
+  Version 1.8
+  * multiply(dst, A, B, workspace) multiplies into caller owned storage with a cache blocked i-k-j loop and swaps
+    buffers with the workspace when dst is an operand, so repeated updates like P = P * F do not allocate.
+    operator*= with a square right hand side works row by row in place.
+
+  Version 1.7
+  * The arithmetic operators build expression templates (MatrixExpression.h) that are evaluated in one fused loop
+    into the destination, so compound expressions no longer allocate a matrix per operator. A product that involves
+    the destination is computed into a temporary first.
+
+  Version 1.6
+  * LUDecomposition factors a square matrix once with partial pivoting and then solves, inverts and gives the
+    determinant from the stored factors. inv() and solveFor() are built on it.
+
+  Version 1.5
+  * leastSquares() solves overdetermined systems, optionally weighted, through a Cholesky factorization of the
+    normal equations. LeastSquaresSolver keeps that factorization and updates it in O(n^2) when a row is added
+    or removed.
+
+  Version 1.4
+  * The elements are stored in one contiguous row-major block together with a row index table, so a matrix
+    costs a single allocation instead of one per row. swapRow() only exchanges two row indices.
+
   Version 1.3
   * Overloading operator [], so we can access the element by using A[][]. Because the internal data structure is a two
     dimensional array, we have to use A[*][0] or A[0][*] to access the element in a column or row matrix.
@@ -39,14 +67,91 @@
 */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include "esphome/core/log.h"
+#include "MatrixExpression.h"
+
+// edge of the square tiles multiply() works through, in elements
+#define MATRIX_BLOCK 32
+// widest square right hand side operator*= multiplies in place, wider ones
+// allocate the product
+#define MATRIX_ROW_BUFFER 32
+
+// Fixed capacity storage for matrices, used through MatrixArenaScope.
+// Allocating bumps an offset, nothing is freed individually; the scope that
+// opened the arena rewinds it when it ends. A request that does not fit fails
+// and is counted, the heap is never used instead.
+class MatrixArena
+{
+public:
+    MatrixArena(void *buffer, size_t capacity);
+    // nullptr when bytes do not fit in what is left
+    void *allocate(size_t bytes);
+    // frees everything allocated since used() returned mark
+    void rewind(size_t mark);
+
+    size_t used() const { return _used; }
+    size_t capacity() const { return _capacity; }
+    // the most that was ever in use at once
+    size_t highWater() const { return _highWater; }
+    // requests that did not fit
+    uint32_t failures() const { return _failures; }
+
+    // the arena matrices are allocated from, nullptr for the heap
+    static MatrixArena *current();
+
+private:
+    unsigned char *_buffer;
+    size_t _capacity;
+    size_t _used;
+    size_t _highWater;
+    uint32_t _failures;
+
+    friend class MatrixArenaScope;
+};
+
+// a MatrixArena with Bytes of storage inline, e.g. a static of a translation unit
+template <size_t Bytes>
+class StaticMatrixArena : public MatrixArena
+{
+public:
+    StaticMatrixArena() : MatrixArena(_storage, Bytes) {}
+
+private:
+    alignas(8) unsigned char _storage[Bytes];
+};
+
+// Every Matrix allocated while the scope is open takes its storage from the
+// arena; when the scope ends the arena is rewound and the previous source is
+// restored. Such matrices must not outlive the scope. Scopes nest.
+class MatrixArenaScope
+{
+public:
+    explicit MatrixArenaScope(MatrixArena &arena);
+    ~MatrixArenaScope();
+    MatrixArenaScope(const MatrixArenaScope &) = delete;
+    MatrixArenaScope &operator=(const MatrixArenaScope &) = delete;
+
+private:
+    MatrixArena &_arena;
+    MatrixArena *_previous;
+    size_t _mark;
+};
 
-class Matrix
+class Matrix : public MatrixExpression<Matrix>
 {
 public:
     int _row;
     int _column;
-    float **_entity;
+    // distance in floats between the start of two consecutive stored rows
+    int _stride;
+    // _perm[i] is the stored row that holds logical row i
+    int *_perm;
+    // _row * _stride elements, allocated in the same block as _perm
+    float *_data;
+    // the arena the block was drawn from, nullptr for the heap
+    MatrixArena *_arena;
     Matrix();
     // ini stands for the initial value of all elements, r is row, c is column
     Matrix(int r, int c, int ini = 0);
@@ -62,32 +167,35 @@ public:
     */
     Matrix(int r, int c, char type);
     ~Matrix();
+    // evaluates an expression such as A * B + C, see MatrixExpression.h
+    template <class E>
+    Matrix(const MatrixExpression<E> &e);
     Matrix &operator*=(float a);
     Matrix &operator*=(const Matrix &A);
     Matrix &operator/=(float a);
     Matrix &operator+=(const Matrix &A);
     Matrix &operator-=(const Matrix &A);
-    Matrix operator*(const Matrix &A);
-    Matrix operator*(float a);
-    template <class G>
-    friend Matrix operator*(G a, const Matrix &A);
-    Matrix operator/(float a);
-    Matrix operator+(const Matrix &A);
+    template <class E>
+    Matrix &operator+=(const MatrixExpression<E> &e);
+    template <class E>
+    Matrix &operator-=(const MatrixExpression<E> &e);
+    // scalar arithmetic with a 1 by 1 matrix
     float operator+(float a);
+    friend float operator+(float a, const Matrix &A);
 
     float *operator[](int index);
+    const float *operator[](int index) const;
 
-    template <class T>
-    friend T operator+(T a, const Matrix &A);
-
-    Matrix operator-(const Matrix &A);
     float operator-(float a);
-    template <class T>
-    friend T operator-(T a, const Matrix &A);
+    friend float operator-(float a, const Matrix &A);
 
     Matrix &operator=(const Matrix &A);
     // move assignment, improve the processing speed
     Matrix &operator=(Matrix &&A);
+    // evaluates the expression into this matrix, reusing its storage when the
+    // shape matches
+    template <class E>
+    Matrix &operator=(const MatrixExpression<E> &e);
     bool operator!=(const Matrix &A);
     bool operator==(const Matrix &A);
     // i: the row needs to be swaped, j: the position the row i goes to, this
@@ -97,15 +205,212 @@ public:
     void show(int decimal = 0);
     // check if it's an empty matrix.
     bool notEmpty();
+
+    // a Matrix is the leaf of every expression
+    static constexpr bool hasProduct = false;
+    int rows() const { return _row; }
+    int columns() const { return _column; }
+    float at(int i, int j) const { return _data[_perm[i] * _stride + j]; }
+    bool references(const Matrix &m) const { return this == &m; }
+    bool conflicts(const Matrix &) const { return false; }
+
+private:
+    // allocates the index table and element storage for an r by c matrix in one block,
+    // the elements are left uninitialised; the matrix is empty when an arena is full
+    void allocate(int r, int c);
+    // frees the storage and leaves an empty matrix behind
+    void release();
+    // writes every element of e into this matrix, which has e's shape
+    template <class E>
+    void evaluate(const E &e);
+    // a plain product of two matrices goes through the blocked multiply() kernel
+    void evaluate(const MatrixProduct<Matrix, Matrix> &e);
+    // gives the matrix the shape r by c, keeping the storage when the shape is unchanged
+    void reshape(int r, int c);
+
+    friend bool multiply(Matrix &dst, const Matrix &A, const Matrix &B, Matrix &workspace);
 };
 
-// The inverse function uses the Gauss-Jordan Elimination,it won't modify
-// the original matrix and it returns the inverse of matrix A
+template <class E>
+void Matrix::evaluate(const E &e)
+{
+    for (int i = 0; i < _row; i++)
+    {
+        float *out = (*this)[i];
+        for (int j = 0; j < _column; j++)
+            out[j] = e.at(i, j);
+    }
+}
+
+template <class E>
+Matrix::Matrix(const MatrixExpression<E> &e)
+{
+    const E &x = e.derived();
+    const int r = x.rows(), c = x.columns();
+    if (r <= 0 || c <= 0)
+    {
+        allocate(0, 0);
+        return;
+    }
+    allocate(r, c);
+    evaluate(x);
+}
+
+template <class E>
+Matrix &Matrix::operator=(const MatrixExpression<E> &e)
+{
+    const E &x = e.derived();
+    const int r = x.rows(), c = x.columns();
+    if (r <= 0 || c <= 0)
+    {
+        release();
+        return *this;
+    }
+    // element-wise reads of this matrix are fine, a product over it is not
+    if (x.conflicts(*this))
+        return *this = Matrix(x);
+
+    if (_perm == nullptr || _row != r || _column != c)
+    {
+        release();
+        allocate(r, c);
+    }
+    evaluate(x);
+    return *this;
+}
+
+template <class E>
+Matrix &Matrix::operator+=(const MatrixExpression<E> &e)
+{
+    const E &x = e.derived();
+    if (_row != x.rows() || _column != x.columns())
+    {
+        release();
+        return *this;
+    }
+    if (x.conflicts(*this))
+        return *this += Matrix(x);
+
+    for (int i = 0; i < _row; i++)
+    {
+        float *row = (*this)[i];
+        for (int j = 0; j < _column; j++)
+            row[j] += x.at(i, j);
+    }
+    return *this;
+}
+
+template <class E>
+Matrix &Matrix::operator-=(const MatrixExpression<E> &e)
+{
+    const E &x = e.derived();
+    if (_row != x.rows() || _column != x.columns())
+    {
+        release();
+        return *this;
+    }
+    if (x.conflicts(*this))
+        return *this -= Matrix(x);
+
+    for (int i = 0; i < _row; i++)
+    {
+        float *row = (*this)[i];
+        for (int j = 0; j < _column; j++)
+            row[j] -= x.at(i, j);
+    }
+    return *this;
+}
+
+// The inverse function uses an LU decomposition with partial pivoting, it won't
+// modify the original matrix and it returns the inverse of matrix A, or an
+// empty matrix when A is singular
 Matrix inv(const Matrix &A);
 // The transpose function won't modify the original matrix and it returns
 // the transpose of matrix A
 Matrix transpose(const Matrix &A);
 
+// dst = A B in caller owned storage. dst is reshaped only when its shape
+// differs from the product's. dst may be A or B: the product is then built in
+// workspace and the two swap storage, so workspace holds dst's old elements
+// afterwards. With matching shapes, repeating the same multiplication never
+// allocates. Returns false, leaving dst empty, when the dimensions don't match.
+bool multiply(Matrix &dst, const Matrix &A, const Matrix &B, Matrix &workspace);
+
 // Solve the matrix equation Ax = v for x; where x, v are column vectors
 // will work on copies of A,v so originals are undisturbed
 Matrix solveFor(Matrix A, Matrix v);
+
+// LU decomposition PA = LU of a square matrix with partial pivoting. The
+// O(n^3) factorization happens once in the constructor; every solve against
+// the same matrix afterwards costs O(n^2) per right hand side. Row exchanges
+// only permute the row index table of the stored factors.
+class LUDecomposition
+{
+public:
+    // factors a copy of A; pass an rvalue to factor in place of the argument's storage
+    LUDecomposition(Matrix A);
+    // true when A was not square or a pivot was zero, nothing can be solved then
+    bool isSingular() const { return _singular; }
+    // x with Ax = b for every column of b, empty when singular or b has the wrong height
+    Matrix solve(const Matrix &b) const;
+    // solves into caller owned x without allocating, x must have b's shape and
+    // may be b itself; false when nothing was solved
+    bool solveInto(const Matrix &b, Matrix &x) const;
+    float determinant() const;
+    // inverse of A, empty when singular
+    Matrix inverse() const;
+    int size() const { return _lu._row; }
+
+private:
+    // unit lower triangle L below the diagonal, U on and above it, rows in pivot order
+    Matrix _lu;
+    // +1 or -1 for an even or odd number of row exchanges
+    int _sign;
+    bool _singular;
+};
+
+// Least-squares solution of Ax = b, A is m by n with m >= n and b is m by 1.
+// Solved through the Cholesky factorization of the normal equations A'A x = A'b;
+// the result is empty when A does not have full column rank.
+Matrix leastSquares(const Matrix &A, const Matrix &b);
+// Weighted least squares, row i of A and b counts with weight w[i][0] >= 0.
+Matrix leastSquares(const Matrix &A, const Matrix &b, const Matrix &w);
+
+// Least-squares fit that is built one observation (row) at a time. The Cholesky
+// factor of the normal equations is kept between solves and updated in O(n^2)
+// when a row is added or removed, so re-measuring one point does not refactor
+// from scratch. All storage is allocated by reset(), adding and removing rows
+// does not allocate. reset() draws from the open MatrixArenaScope like any
+// Matrix, so a solver that outlives the scope must be reset outside of it.
+class LeastSquaresSolver
+{
+public:
+    LeastSquaresSolver(int n = 0);
+    // forgets all rows, n is the number of unknowns
+    void reset(int n);
+    // adds the observation a . x = b with weight w, a has n elements
+    void addRow(const float *a, float b, float w = 1);
+    // removes an observation that was added before with the same values
+    void removeRow(const float *a, float b, float w = 1);
+    // n by 1 solution, empty while the rows do not determine x
+    Matrix solve();
+    // number of rows currently in the fit
+    int rows() const { return _rows; }
+    int unknowns() const { return _n; }
+
+private:
+    int _n;
+    int _rows;
+    // normal equations A'WA and A'Wb, always up to date
+    Matrix _gram;
+    Matrix _rhs;
+    // lower triangular L with LL' = A'WA, only meaningful while _factored
+    Matrix _factor;
+    bool _factored;
+    Matrix _work;
+
+    // rank one update (sign = 1) or downdate (sign = -1) of the factor with
+    // _work, false when the factor stops being positive definite
+    bool updateFactor(float sign);
+    bool factor();
+};
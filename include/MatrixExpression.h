@@ -0,0 +1,214 @@
+/*
+  MatrixExpression.h - Lazy arithmetic for Matrix.
+
+  The operators +, -, * and / on matrices do not compute anything. They return
+  a small expression object that records the operands, and the work happens
+  when the expression is assigned to (or used to construct) a Matrix. Then
+  every element of the destination is computed in one loop, straight from the
+  operands:
+
+      x = F * x + B * u;      // one pass over x, no intermediate matrices
+
+  Element-wise operations (+, -, scaling) read only the same element of their
+  operands, so they may safely name the destination. A product reads whole
+  rows and columns; when the destination takes part in a product the result is
+  computed into a temporary and moved into place, so A = A * B still works.
+
+  A product reads each element of its operands many times. An operand that
+  contains a product itself is therefore evaluated into a temporary Matrix
+  when the expression is built, which keeps (F * P) * Ft at the cost of one
+  ordinary product.
+
+  Invalid dimensions lead to an empty matrix, like the rest of Matrix.h.
+  Expressions refer to their Matrix operands, don't keep them (e.g. in an
+  auto variable) beyond the statement that built them.
+*/
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+class Matrix;
+
+// Base of everything that can be evaluated into a Matrix. E provides
+// rows(), columns(), at(i, j), references(m), conflicts(m) and hasProduct.
+template <class E>
+struct MatrixExpression
+{
+    const E &derived() const { return static_cast<const E &>(*this); }
+};
+
+namespace matrix_expression_detail
+{
+    template <class T>
+    using bare = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+    template <class T>
+    struct isExpression : std::is_base_of<MatrixExpression<bare<T>>, bare<T>>
+    {
+    };
+
+    // Matrix leaves are held by reference, expression nodes by value
+    template <class E>
+    struct operand
+    {
+        using type = E;
+    };
+
+    template <>
+    struct operand<Matrix>
+    {
+        using type = const Matrix &;
+    };
+
+    // operands of a product that contain a product are evaluated first
+    template <class E>
+    struct productOperand
+    {
+        using type = typename std::conditional<E::hasProduct, Matrix, typename operand<E>::type>::type;
+    };
+
+    struct plus
+    {
+        static float apply(float a, float b) { return a + b; }
+    };
+
+    struct minus
+    {
+        static float apply(float a, float b) { return a - b; }
+    };
+
+    struct multiplies
+    {
+        static float apply(float a, float b) { return a * b; }
+    };
+
+    struct divides
+    {
+        static float apply(float a, float b) { return a / b; }
+    };
+}
+
+// l op r for every element, l and r must have the same shape
+template <class L, class R, class Op>
+class MatrixElementwise : public MatrixExpression<MatrixElementwise<L, R, Op>>
+{
+public:
+    static constexpr bool hasProduct = L::hasProduct || R::hasProduct;
+
+    template <class A, class B>
+    MatrixElementwise(A &&l, B &&r) : _l(std::forward<A>(l)), _r(std::forward<B>(r)) {}
+
+    int rows() const { return sameShape() ? _l.rows() : 0; }
+    int columns() const { return sameShape() ? _l.columns() : 0; }
+    float at(int i, int j) const { return Op::apply(_l.at(i, j), _r.at(i, j)); }
+    bool references(const Matrix &m) const { return _l.references(m) || _r.references(m); }
+    bool conflicts(const Matrix &m) const { return _l.conflicts(m) || _r.conflicts(m); }
+
+private:
+    typename matrix_expression_detail::operand<L>::type _l;
+    typename matrix_expression_detail::operand<R>::type _r;
+
+    bool sameShape() const { return _l.rows() == _r.rows() && _l.columns() == _r.columns(); }
+};
+
+// e op a for every element
+template <class E, class Op>
+class MatrixScalar : public MatrixExpression<MatrixScalar<E, Op>>
+{
+public:
+    static constexpr bool hasProduct = E::hasProduct;
+
+    template <class A>
+    MatrixScalar(A &&e, float a) : _e(std::forward<A>(e)), _a(a) {}
+
+    int rows() const { return _e.rows(); }
+    int columns() const { return _e.columns(); }
+    float at(int i, int j) const { return Op::apply(_e.at(i, j), _a); }
+    bool references(const Matrix &m) const { return _e.references(m); }
+    bool conflicts(const Matrix &m) const { return _e.conflicts(m); }
+
+private:
+    typename matrix_expression_detail::operand<E>::type _e;
+    float _a;
+};
+
+// the matrix product l r, l must have as many columns as r has rows
+template <class L, class R>
+class MatrixProduct : public MatrixExpression<MatrixProduct<L, R>>
+{
+public:
+    static constexpr bool hasProduct = true;
+
+    template <class A, class B>
+    MatrixProduct(A &&l, B &&r) : _l(std::forward<A>(l)), _r(std::forward<B>(r)) {}
+
+    int rows() const { return _l.columns() == _r.rows() ? _l.rows() : 0; }
+    int columns() const { return _l.columns() == _r.rows() ? _r.columns() : 0; }
+    float at(int i, int j) const
+    {
+        float sum = 0;
+        for (int k = 0; k < _l.columns(); k++)
+            sum += _l.at(i, k) * _r.at(k, j);
+        return sum;
+    }
+    bool references(const Matrix &m) const { return _l.references(m) || _r.references(m); }
+    // every element of the operands feeds several results
+    bool conflicts(const Matrix &m) const { return references(m); }
+    const typename matrix_expression_detail::productOperand<L>::type &left() const { return _l; }
+    const typename matrix_expression_detail::productOperand<R>::type &right() const { return _r; }
+
+private:
+    typename matrix_expression_detail::productOperand<L>::type _l;
+    typename matrix_expression_detail::productOperand<R>::type _r;
+};
+
+template <class L, class R>
+using MatrixSum = MatrixElementwise<L, R, matrix_expression_detail::plus>;
+template <class L, class R>
+using MatrixDifference = MatrixElementwise<L, R, matrix_expression_detail::minus>;
+
+template <class L, class R,
+          typename std::enable_if<matrix_expression_detail::isExpression<L>::value &&
+                                      matrix_expression_detail::isExpression<R>::value,
+                                  int>::type = 0>
+MatrixSum<matrix_expression_detail::bare<L>, matrix_expression_detail::bare<R>> operator+(L &&l, R &&r)
+{
+    return {std::forward<L>(l), std::forward<R>(r)};
+}
+
+template <class L, class R,
+          typename std::enable_if<matrix_expression_detail::isExpression<L>::value &&
+                                      matrix_expression_detail::isExpression<R>::value,
+                                  int>::type = 0>
+MatrixDifference<matrix_expression_detail::bare<L>, matrix_expression_detail::bare<R>> operator-(L &&l, R &&r)
+{
+    return {std::forward<L>(l), std::forward<R>(r)};
+}
+
+template <class L, class R,
+          typename std::enable_if<matrix_expression_detail::isExpression<L>::value &&
+                                      matrix_expression_detail::isExpression<R>::value,
+                                  int>::type = 0>
+MatrixProduct<matrix_expression_detail::bare<L>, matrix_expression_detail::bare<R>> operator*(L &&l, R &&r)
+{
+    return {std::forward<L>(l), std::forward<R>(r)};
+}
+
+template <class E, typename std::enable_if<matrix_expression_detail::isExpression<E>::value, int>::type = 0>
+MatrixScalar<matrix_expression_detail::bare<E>, matrix_expression_detail::multiplies> operator*(E &&e, float a)
+{
+    return {std::forward<E>(e), a};
+}
+
+template <class E, typename std::enable_if<matrix_expression_detail::isExpression<E>::value, int>::type = 0>
+MatrixScalar<matrix_expression_detail::bare<E>, matrix_expression_detail::multiplies> operator*(float a, E &&e)
+{
+    return {std::forward<E>(e), a};
+}
+
+template <class E, typename std::enable_if<matrix_expression_detail::isExpression<E>::value, int>::type = 0>
+MatrixScalar<matrix_expression_detail::bare<E>, matrix_expression_detail::divides> operator/(E &&e, float a)
+{
+    return {std::forward<E>(e), a};
+}
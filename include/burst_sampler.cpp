@@ -0,0 +1,100 @@
+#include "burst_sampler.h"
+#include <algorithm>
+#include <cmath>
+
+static const char *const TAG = "burst_sampler";
+
+float medianOf(float *samples, size_t n)
+{
+    if (n == 0)
+        return NAN;
+
+    float *mid = samples + n / 2;
+    std::nth_element(samples, mid, samples + n);
+    if (n % 2 == 1)
+        return *mid;
+
+    // even count: the lower middle is the largest value left of mid
+    const float lower = *std::max_element(samples, mid);
+    return (lower + *mid) / 2;
+}
+
+float trimmedMeanOf(float *samples, size_t n, float trim)
+{
+    if (n == 0)
+        return NAN;
+
+    size_t k = trim > 0 ? (size_t)(trim * n) : 0;
+    if (2 * k >= n)
+        k = (n - 1) / 2;
+
+    if (k > 0)
+    {
+        // the k smallest end up in [0, k), the k largest in [n - k, n)
+        std::nth_element(samples, samples + k, samples + n);
+        std::nth_element(samples + k, samples + (n - k - 1), samples + n);
+    }
+
+    float sum = 0;
+    for (size_t i = k; i < n - k; i++)
+        sum += samples[i];
+    return sum / (n - 2 * k);
+}
+
+void BurstSampler::configure(uint8_t samples, SampleReduction reduction, float trim)
+{
+    if (samples > BURST_MAX_SAMPLES)
+    {
+        esphome::ESP_LOGW(TAG, "burst of %u samples requested, limiting to %u", samples, BURST_MAX_SAMPLES);
+        samples = BURST_MAX_SAMPLES;
+    }
+    this->samples_ = samples;
+    this->reduction_ = reduction;
+    this->trim_ = trim < 0 ? 0 : (trim >= 0.5 ? 0.49 : trim);
+}
+
+float BurstSampler::read(esphome::adc::ADCSensor *adc)
+{
+    if (!this->enabled())
+    {
+        this->variance_ = NAN;
+        return adc->state;
+    }
+
+    AdcSampleSource source(adc);
+    const float v = this->read(&source);
+    return std::isnan(v) ? adc->state : v;
+}
+
+float BurstSampler::read(SampleSource *source)
+{
+    float samples[BURST_MAX_SAMPLES];
+    const size_t got = source->read(samples, this->samples_ > 1 ? this->samples_ : 1);
+
+    // a failed conversion reads NaN, leave it out rather than poison the burst
+    size_t n = 0;
+    for (size_t i = 0; i < got; i++)
+        if (!std::isnan(samples[i]))
+            samples[n++] = samples[i];
+
+    this->variance_ = NAN;
+    if (n == 0)
+        return NAN;
+    if (n == 1)
+        return samples[0];
+
+    // variance of the mean of n samples; the median scatters pi / 2 times as
+    // much for normal noise, which also covers the trimmed mean
+    float mean = 0, m2 = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const float delta = samples[i] - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (samples[i] - mean);
+    }
+    this->variance_ = m2 / (n - 1) / n * (this->reduction_ == SampleReduction::MEDIAN ? 1.571f : 1.0f);
+
+    if (this->reduction_ == SampleReduction::TRIMMED_MEAN)
+        return trimmedMeanOf(samples, n, this->trim_);
+    return medianOf(samples, n);
+}
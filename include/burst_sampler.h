@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "esphome/components/adc/adc_sensor.h"
+#include "sample_source.h"
+
+// upper bound on the conversions in one burst, the samples live on the stack
+#define BURST_MAX_SAMPLES 64
+
+enum class SampleReduction : uint8_t
+{
+    MEDIAN,
+    TRIMMED_MEAN,
+};
+
+// Median of samples[0..n). Reorders the buffer; O(n) on average.
+float medianOf(float *samples, size_t n);
+
+// Mean of samples[0..n) after dropping the lowest and highest trim fraction
+// (0 <= trim < 0.5) of the values. Reorders the buffer; O(n) on average.
+float trimmedMeanOf(float *samples, size_t n, float trim);
+
+// Takes a burst of back to back ADC conversions at update time and reduces
+// them to one robust reading, instead of using the value the ADC component
+// sampled on its own schedule.
+class BurstSampler
+{
+public:
+    // samples <= 1 disables bursts, read() then returns the ADC's last state
+    void configure(uint8_t samples, SampleReduction reduction = SampleReduction::MEDIAN, float trim = 0.2);
+
+    float read(esphome::adc::ADCSensor *adc);
+    // reduces one block of max(samples, 1) voltages of source, NAN when all failed
+    float read(SampleSource *source);
+
+    bool enabled() const { return this->samples_ > 1; }
+
+    // estimated variance (V^2) of the last reading, from the spread of its
+    // burst; NAN when the reading came from a single conversion
+    float variance() const { return this->variance_; }
+
+protected:
+    uint8_t samples_ = 1;
+    SampleReduction reduction_ = SampleReduction::MEDIAN;
+    float trim_ = 0.2;
+    float variance_ = NAN;
+};
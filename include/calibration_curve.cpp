@@ -0,0 +1,237 @@
+#include "calibration_curve.h"
+#include "Matrix.h"
+#include <cmath>
+
+static StaticMatrixArena<CALIBRATION_ARENA_BYTES> arena;
+
+MatrixArena &calibrationArena()
+{
+    return arena;
+}
+
+// insertion sort of n points by x into xs, ys; the caller's order is arbitrary
+static void sortByX(const float *x, const float *y, uint8_t n, float *xs, float *ys)
+{
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint8_t j = i;
+        for (; j > 0 && xs[j - 1] > x[i]; j--)
+        {
+            xs[j] = xs[j - 1];
+            ys[j] = ys[j - 1];
+        }
+        xs[j] = x[i];
+        ys[j] = y[i];
+    }
+}
+
+bool PiecewiseLinearCalibration::set(const float *x, const float *y, uint8_t count)
+{
+    if (count < 2 || count > CALIBRATION_MAX_POINTS)
+        return false;
+    for (uint8_t i = 1; i < count; i++)
+        if (!(x[i] > x[i - 1]))
+            return false;
+
+    const uint8_t next = this->active_.load(std::memory_order_relaxed) ^ 1;
+    Bank &bank = this->banks_[next];
+    for (uint8_t i = 0; i + 1 < count; i++)
+    {
+        bank.knots[i] = x[i];
+        bank.slope[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]);
+        bank.intercept[i] = y[i] - bank.slope[i] * x[i];
+    }
+    bank.segments = count - 1;
+    this->active_.store(next, std::memory_order_release);
+    return true;
+}
+
+float PiecewiseLinearCalibration::evaluate(float x) const
+{
+    const Bank &bank = this->banks_[this->active_.load(std::memory_order_acquire)];
+    if (bank.segments == 0)
+        return x;
+
+    // the first segment also covers everything below the first knot
+    uint8_t s = 0;
+    while (s + 1 < bank.segments && x >= bank.knots[s + 1])
+        s++;
+    return bank.slope[s] * x + bank.intercept[s];
+}
+
+void PiecewiseLinearCalibration::evaluate(const float *x, float *y, size_t n) const
+{
+    const Bank &bank = this->banks_[this->active_.load(std::memory_order_acquire)];
+    for (size_t k = 0; k < n; k++)
+    {
+        if (bank.segments == 0)
+        {
+            y[k] = x[k];
+            continue;
+        }
+        uint8_t s = 0;
+        while (s + 1 < bank.segments && x[k] >= bank.knots[s + 1])
+            s++;
+        y[k] = bank.slope[s] * x[k] + bank.intercept[s];
+    }
+}
+
+bool CalibrationCurve::fit(CalibrationStrategy strategy, const float *x, const float *y, uint8_t n)
+{
+    if (n > CALIBRATION_MAX_POINTS)
+        n = CALIBRATION_MAX_POINTS;
+
+    switch (strategy)
+    {
+    case CalibrationStrategy::LINEAR:
+    {
+        if (n < 2 || x[0] == x[1])
+            return false;
+        const float slope = (y[1] - y[0]) / (x[1] - x[0]);
+        const float coefficients[2] = {y[0] - slope * x[0], slope};
+        return this->setPolynomial(strategy, coefficients, 2);
+    }
+    case CalibrationStrategy::QUADRATIC:
+    {
+        if (n < 3)
+            return false;
+        const FixedMatrix<3, 1> C = quadraticThrough(x[0], y[0], x[1], y[1], x[2], y[2]);
+        if (!C.notEmpty())
+            return false;
+        const float coefficients[3] = {C[0][0], C[1][0], C[2][0]};
+        return this->setPolynomial(strategy, coefficients, 3);
+    }
+    case CalibrationStrategy::PIECEWISE_LINEAR:
+    {
+        float xs[CALIBRATION_MAX_POINTS], ys[CALIBRATION_MAX_POINTS];
+        sortByX(x, y, n, xs, ys);
+        if (!this->piecewise_.set(xs, ys, n))
+            return false;
+        this->strategy_.store(strategy, std::memory_order_release);
+        return true;
+    }
+    case CalibrationStrategy::LEAST_SQUARES:
+    {
+        const int terms = this->degree_ + 1;
+        if (n < terms)
+            return false;
+
+        MatrixArenaScope scope(calibrationArena());
+
+        float mean = 0;
+        for (uint8_t i = 0; i < n; i++)
+            mean += x[i];
+        mean /= n;
+
+        Matrix A(n, terms);
+        Matrix b(n, 1);
+        if (!A.notEmpty() || !b.notEmpty())
+            return false;
+        for (uint8_t i = 0; i < n; i++)
+        {
+            float p = 1;
+            for (int k = 0; k < terms; k++, p *= x[i] - mean)
+                A[i][k] = p;
+            b[i][0] = y[i];
+        }
+
+        Matrix a = leastSquares(A, b);
+        if (!a.notEmpty())
+            return false;
+
+        float centered[3], coefficients[3];
+        for (int k = 0; k < terms; k++)
+            centered[k] = a[k][0];
+        expandAround(centered, terms, mean, coefficients);
+        return this->setPolynomial(strategy, coefficients, terms);
+    }
+    }
+    return false;
+}
+
+bool CalibrationCurve::setPolynomial(CalibrationStrategy strategy, const float *coefficients, uint8_t count)
+{
+    if (strategy == CalibrationStrategy::PIECEWISE_LINEAR || !this->polynomial_.set(coefficients, count))
+        return false;
+    this->strategy_.store(strategy, std::memory_order_release);
+    return true;
+}
+
+uint8_t CalibrationCurve::coefficients(float *out) const
+{
+    if (this->strategy() == CalibrationStrategy::PIECEWISE_LINEAR)
+        return 0;
+    return this->polynomial_.get(out);
+}
+
+const char *calibrationStrategyName(CalibrationStrategy strategy)
+{
+    switch (strategy)
+    {
+    case CalibrationStrategy::LINEAR:
+        return "linear";
+    case CalibrationStrategy::QUADRATIC:
+        return "quadratic";
+    case CalibrationStrategy::PIECEWISE_LINEAR:
+        return "piecewise linear";
+    case CalibrationStrategy::LEAST_SQUARES:
+        return "least squares";
+    }
+    return "unknown";
+}
+
+CalibrationCheck checkCalibrationPoints(const float *x, const float *y, uint8_t n, float minSlope, float maxSlope)
+{
+    if (n > CALIBRATION_MAX_POINTS)
+        n = CALIBRATION_MAX_POINTS;
+    if (n < 2)
+        return CalibrationCheck::TOO_FEW_POINTS;
+
+    float xs[CALIBRATION_MAX_POINTS], ys[CALIBRATION_MAX_POINTS];
+    sortByX(x, y, n, xs, ys);
+
+    const bool rising = ys[n - 1] > ys[0];
+    for (uint8_t i = 1; i < n; i++)
+        if (!(xs[i] > xs[i - 1]) || !(rising ? ys[i] > ys[i - 1] : ys[i] < ys[i - 1]))
+            return CalibrationCheck::NOT_MONOTONIC;
+
+    const float slope = fabsf((ys[n - 1] - ys[0]) / (xs[n - 1] - xs[0]));
+    if (!(slope >= minSlope && slope <= maxSlope))
+        return CalibrationCheck::SLOPE_OUT_OF_RANGE;
+    return CalibrationCheck::OK;
+}
+
+const char *calibrationCheckName(CalibrationCheck check)
+{
+    switch (check)
+    {
+    case CalibrationCheck::OK:
+        return "ok";
+    case CalibrationCheck::TOO_FEW_POINTS:
+        return "too few points";
+    case CalibrationCheck::NOT_MONOTONIC:
+        return "points are not monotonic";
+    case CalibrationCheck::SLOPE_OUT_OF_RANGE:
+        return "slope out of range";
+    }
+    return "unknown";
+}
+
+void expandAround(const float *a, uint8_t count, float center, float *c)
+{
+    for (uint8_t j = 0; j < count; j++)
+        c[j] = 0;
+
+    // (x - center)^k = sum over j of binom(k, j) x^j (-center)^(k - j)
+    for (uint8_t k = 0; k < count; k++)
+    {
+        float binom = 1;
+        float power = 1;
+        for (int j = k; j >= 0; j--)
+        {
+            c[j] += a[k] * binom * power;
+            binom = binom * j / (k - j + 1);
+            power *= -center;
+        }
+    }
+}
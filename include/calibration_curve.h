@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "FixedMatrix.h"
+#include "polynomial_calibration.h"
+
+// upper bound on the points one calibration can be fitted through
+#define CALIBRATION_MAX_POINTS 8
+// room for the temporary matrices of one least-squares refit over
+// CALIBRATION_MAX_POINTS points
+#define CALIBRATION_ARENA_BYTES 512
+
+class MatrixArena;
+
+enum class CalibrationStrategy : uint8_t
+{
+    // line through the first two points
+    LINEAR = 0,
+    // parabola exactly through the first three points
+    QUADRATIC = 1,
+    // straight segments between all points, extrapolated beyond the outer ones
+    PIECEWISE_LINEAR = 2,
+    // least-squares polynomial over all points
+    LEAST_SQUARES = 3,
+};
+
+// Fits y = c0 + c1 x + c2 x^2 exactly through three (x, y) points. The result
+// is the column {c0, c1, c2}, or an empty matrix when two x values coincide.
+constexpr FixedMatrix<3, 1> quadraticThrough(float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    return solveFor(FixedMatrix<3, 3>{{{1, x1, x1 * x1},
+                                       {1, x2, x2 * x2},
+                                       {1, x3, x3 * x3}}},
+                    FixedMatrix<3, 1>{{{y1},
+                                       {y2},
+                                       {y3}}});
+}
+
+// Straight segments between sorted knots. Like PolynomialCalibration the table
+// is double buffered, so a reader never sees a half written table.
+class PiecewiseLinearCalibration
+{
+public:
+    // x must be strictly increasing, 2 <= count <= CALIBRATION_MAX_POINTS
+    bool set(const float *x, const float *y, uint8_t count);
+    float evaluate(float x) const;
+    void evaluate(const float *x, float *y, size_t n) const;
+
+protected:
+    struct Bank
+    {
+        // knots[i] starts segment i, which is y = slope[i] x + intercept[i]
+        float knots[CALIBRATION_MAX_POINTS] = {0};
+        float slope[CALIBRATION_MAX_POINTS - 1] = {0};
+        float intercept[CALIBRATION_MAX_POINTS - 1] = {0};
+        uint8_t segments = 0;
+    };
+
+    Bank banks_[2];
+    std::atomic<uint8_t> active_{0};
+};
+
+// A calibration curve from raw readings (x) to values (y) with a selectable
+// fitting strategy. All fitting happens in fit() when the calibration points
+// change, so evaluate() is a single polynomial or segment expression. Nothing
+// here allocates.
+class CalibrationCurve
+{
+public:
+    // Fits the curve through n points. Returns false, keeping the previous
+    // curve, when the points can not support the strategy (too few points or
+    // coinciding x values).
+    bool fit(CalibrationStrategy strategy, const float *x, const float *y, uint8_t n);
+
+    // installs polynomial coefficients computed elsewhere, e.g. at compile time
+    bool setPolynomial(CalibrationStrategy strategy, const float *coefficients, uint8_t count);
+
+    float evaluate(float x) const
+    {
+        if (this->strategy_.load(std::memory_order_acquire) == CalibrationStrategy::PIECEWISE_LINEAR)
+            return this->piecewise_.evaluate(x);
+        return this->polynomial_.evaluate(x);
+    }
+
+    // evaluates n readings against one consistent curve, x and y may be the same array
+    void evaluate(const float *x, float *y, size_t n) const
+    {
+        if (this->strategy_.load(std::memory_order_acquire) == CalibrationStrategy::PIECEWISE_LINEAR)
+            this->piecewise_.evaluate(x, y, n);
+        else
+            this->polynomial_.evaluate(x, y, n);
+    }
+
+    CalibrationStrategy strategy() const { return this->strategy_.load(std::memory_order_relaxed); }
+
+    // polynomial degree used by LEAST_SQUARES, 1 or 2
+    void setLeastSquaresDegree(uint8_t degree) { this->degree_ = degree < 1 ? 1 : (degree > 2 ? 2 : degree); }
+    uint8_t leastSquaresDegree() const { return this->degree_; }
+
+    // copies the polynomial coefficients into out and returns their count, 0 for piecewise curves
+    uint8_t coefficients(float *out) const;
+
+protected:
+    PolynomialCalibration polynomial_;
+    PiecewiseLinearCalibration piecewise_;
+    std::atomic<CalibrationStrategy> strategy_{CalibrationStrategy::LINEAR};
+    uint8_t degree_ = 1;
+};
+
+const char *calibrationStrategyName(CalibrationStrategy strategy);
+
+// Least-squares refits take their temporary matrices from this fixed arena
+// instead of the heap, see MatrixArenaScope.
+MatrixArena &calibrationArena();
+
+enum class CalibrationCheck : uint8_t
+{
+    OK = 0,
+    // fewer than two points
+    TOO_FEW_POINTS,
+    // y does not strictly rise or strictly fall with x
+    NOT_MONOTONIC,
+    // |slope| between the outer points is outside the allowed range
+    SLOPE_OUT_OF_RANGE,
+};
+
+// Sanity checks calibration points before they are fitted: sorted by x the y
+// values must move in one direction, and the overall slope magnitude must be
+// within [minSlope, maxSlope].
+CalibrationCheck checkCalibrationPoints(const float *x, const float *y, uint8_t n, float minSlope, float maxSlope);
+
+const char *calibrationCheckName(CalibrationCheck check);
+
+// Rewrites the polynomial sum a[k] (x - center)^k as sum c[k] x^k. Fits are
+// done around a center to keep their normal equations well conditioned.
+void expandAround(const float *a, uint8_t count, float center, float *c);
@@ -0,0 +1,15 @@
+#include "calibration_session.h"
+
+uint32_t calibrationCrc(const void *data, size_t length)
+{
+    // bitwise, records are checked once at boot and once per calibration
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3) of length bytes
+uint32_t calibrationCrc(const void *data, size_t length);
+
+// Persisted calibration records start with a uint16_t version and end with a
+// uint32_t crc over everything before it. Records hold plain values only, no
+// pointers, and are laid out without padding so the CRC covers no stray bytes.
+template <typename T>
+void sealCalibrationRecord(T &record, uint16_t version)
+{
+    record.version = version;
+    record.crc = calibrationCrc(&record, offsetof(T, crc));
+}
+
+// false for records of another version, never written or damaged in flash
+template <typename T>
+bool calibrationRecordValid(const T &record, uint16_t version)
+{
+    return record.version == version && record.crc == calibrationCrc(&record, offsetof(T, crc));
+}
+
+// Calibration points measured between begin and commit are staged on a copy
+// of the committed record in RAM. The owner validates and fits the staged
+// record once when the session ends and persists it with a single write; an
+// aborted session leaves the committed calibration untouched.
+template <typename T>
+class CalibrationSession
+{
+public:
+    // starts from the committed record, so points that are not re-measured carry over
+    void begin(const T &committed)
+    {
+        this->staged_ = committed;
+        this->open_ = true;
+        this->changes_ = 0;
+    }
+
+    void close() { this->open_ = false; }
+
+    bool open() const { return this->open_; }
+
+    // the record to change, call changed() afterwards
+    T &staged() { return this->staged_; }
+    const T &staged() const { return this->staged_; }
+
+    void changed() { this->changes_++; }
+    // points staged since begin()
+    uint8_t changes() const { return this->changes_; }
+
+protected:
+    T staged_{};
+    bool open_ = false;
+    uint8_t changes_ = 0;
+};
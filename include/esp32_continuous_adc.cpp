@@ -0,0 +1,174 @@
+#include "esp32_continuous_adc.h"
+
+#if defined(USE_ESP32) || defined(USE_HOST)
+
+#include <cmath>
+#include "esphome/core/log.h"
+
+static const char *const TAG = "continuous_adc";
+
+// raw conversions drained from the driver per call, 2 bytes each
+#define CONTINUOUS_ADC_CHUNK 128
+// ms of conversions the driver's ring holds between two drains
+#define CONTINUOUS_ADC_RING_MS 100
+
+Esp32ContinuousAdc::Esp32ContinuousAdc(adc1_channel_t channel, adc_atten_t attenuation, uint32_t sampleRate,
+                                       uint16_t decimation)
+    : channel_(channel), attenuation_(attenuation), rate_(sampleRate), decimation_(decimation > 0 ? decimation : 1)
+{
+}
+
+Esp32ContinuousAdc::~Esp32ContinuousAdc()
+{
+    this->stop();
+}
+
+float Esp32ContinuousAdc::get_setup_priority() const
+{
+    return esphome::setup_priority::HARDWARE;
+}
+
+void Esp32ContinuousAdc::setup()
+{
+    if (!this->start())
+        this->mark_failed();
+}
+
+void Esp32ContinuousAdc::loop()
+{
+    this->drain();
+}
+
+void Esp32ContinuousAdc::dump_config()
+{
+    esphome::ESP_LOGCONFIG(TAG, "Continuous ADC:");
+    esphome::ESP_LOGCONFIG(TAG, "  Channel: ADC1_%u, %u Hz, %u samples/s", (unsigned)this->channel_, this->rate_,
+                           this->sample_rate());
+    esphome::ESP_LOGCONFIG(TAG, "  Overflows: %u", this->overflows_);
+}
+
+bool Esp32ContinuousAdc::start()
+{
+    if (this->running_)
+        return true;
+
+    // whole chunks, at least 4 and at most 64 of them
+    uint32_t chunks = this->rate_ / 1000 * CONTINUOUS_ADC_RING_MS / CONTINUOUS_ADC_CHUNK + 1;
+    chunks = chunks < 4 ? 4 : (chunks > 64 ? 64 : chunks);
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = chunks * CONTINUOUS_ADC_CHUNK * sizeof(adc_digi_output_data_t);
+    init.conv_num_each_intr = CONTINUOUS_ADC_CHUNK;
+    init.adc1_chan_mask = 1 << this->channel_;
+    init.adc2_chan_mask = 0;
+    esp_err_t err = adc_digi_initialize(&init);
+    if (err != ESP_OK)
+    {
+        esphome::ESP_LOGE(TAG, "adc_digi_initialize failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = this->attenuation_;
+    pattern.channel = this->channel_;
+    pattern.unit = 0;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+    adc_digi_configuration_t config = {};
+    // the ESP32 controller needs a conversion limit
+    config.conv_limit_en = 1;
+    config.conv_limit_num = 250;
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = this->rate_;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    err = adc_digi_controller_configure(&config);
+    if (err == ESP_OK)
+        err = adc_digi_start();
+    if (err != ESP_OK)
+    {
+        esphome::ESP_LOGE(TAG, "starting continuous conversions failed: %s", esp_err_to_name(err));
+        adc_digi_deinitialize();
+        return false;
+    }
+
+    esp_adc_cal_characterize(ADC_UNIT_1, this->attenuation_, ADC_WIDTH_BIT_12, 1100, &this->characteristics_);
+    this->sum_ = 0;
+    this->summed_ = 0;
+    this->read_ = this->written_;
+    this->running_ = true;
+    return true;
+}
+
+void Esp32ContinuousAdc::stop()
+{
+    if (!this->running_)
+        return;
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    this->running_ = false;
+}
+
+void Esp32ContinuousAdc::drain()
+{
+    if (!this->running_)
+        return;
+
+    adc_digi_output_data_t raw[CONTINUOUS_ADC_CHUNK];
+    while (true)
+    {
+        uint32_t got = 0;
+        const esp_err_t err = adc_digi_read_bytes((uint8_t *)raw, sizeof(raw), &got, 0);
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // the ring overflowed since the last drain and conversions were
+            // lost; restart the decimation so no sample spans the gap
+            if (this->overflows_++ == 0)
+                esphome::ESP_LOGW(TAG, "conversions were lost, the loop did not drain the ring within %u ms",
+                                  CONTINUOUS_ADC_RING_MS);
+            this->sum_ = 0;
+            this->summed_ = 0;
+        }
+        else if (err != ESP_OK)
+            break;
+
+        for (uint32_t i = 0; i < got / sizeof(raw[0]); i++)
+        {
+            if (raw[i].type1.channel != this->channel_)
+                continue;
+            this->sum_ += raw[i].type1.data;
+            if (++this->summed_ == this->decimation_)
+            {
+                const uint32_t mV = esp_adc_cal_raw_to_voltage(this->sum_ / this->summed_, &this->characteristics_);
+                this->samples_[this->written_++ % CONTINUOUS_ADC_SAMPLES] = mV / 1000.0f;
+                this->sum_ = 0;
+                this->summed_ = 0;
+            }
+        }
+        if (got < sizeof(raw))
+            break;
+    }
+}
+
+size_t Esp32ContinuousAdc::read(float *buffer, size_t count)
+{
+    if (!this->running_ && !this->start())
+    {
+        for (size_t i = 0; i < count; i++)
+            buffer[i] = NAN;
+        return count;
+    }
+
+    this->drain();
+    uint32_t fresh = this->written_ - this->read_;
+    if (fresh > CONTINUOUS_ADC_SAMPLES)
+        fresh = CONTINUOUS_ADC_SAMPLES;
+    const size_t n = count < fresh ? count : fresh;
+    // the newest n, oldest first
+    for (size_t i = 0; i < n; i++)
+        buffer[i] = this->samples_[(this->written_ - n + i) % CONTINUOUS_ADC_SAMPLES];
+    this->read_ = this->written_;
+    return n;
+}
+
+#endif
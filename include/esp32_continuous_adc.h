@@ -0,0 +1,76 @@
+#pragma once
+
+// Continuous (DMA) sampling of one ADC1 channel on the ESP32, using the
+// adc_digi driver of ESP-IDF 4.4 (Arduino ESP32 2.x). Only compiled for the
+// ESP32, the driver is a device feature; the host build runs it against the
+// driver stand-in in host/driver/adc.h.
+#if defined(USE_ESP32) || defined(USE_HOST)
+
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include "esphome/core/component.h"
+#include "sample_source.h"
+
+// decimated samples kept for read(), at least BURST_MAX_SAMPLES
+#define CONTINUOUS_ADC_SAMPLES 64
+
+// The driver fills a ring of DMA buffers at sample_rate (20 kHz to 2 MHz) in
+// the background. Every `decimation` raw conversions are averaged into one
+// sample, which lowers the rate to the probes' bandwidth and averages the
+// noise. A read of 50 Hz worth of decimated samples also cancels mains hum.
+//
+// loop() drains the ring without waiting and keeps the newest
+// CONTINUOUS_ADC_SAMPLES samples; read() never blocks, it returns the newest
+// samples converted since the previous read, none when there are none yet.
+// The ring holds about 100 ms of conversions; when the main loop stalls for
+// longer the driver drops conversions, which overflows() counts.
+//
+// The ESP32 has one digital controller, and it owns ADC1 while it runs:
+// one-shot conversions of other ADC1 channels, which ESPHome's adc sensors
+// use, are not supported at the same time. Register it as a component, its
+// setup() starts the conversions.
+class Esp32ContinuousAdc : public SampleSource, public esphome::Component
+{
+public:
+    Esp32ContinuousAdc(adc1_channel_t channel, adc_atten_t attenuation = ADC_ATTEN_DB_11,
+                       uint32_t sampleRate = 20000, uint16_t decimation = 100);
+    ~Esp32ContinuousAdc() override;
+
+    // installs the driver and starts the conversions, false on a driver error
+    bool start();
+    void stop();
+
+    size_t read(float *buffer, size_t count) override;
+    uint32_t sample_rate() const override { return this->rate_ / this->decimation_; }
+
+    // times the driver reported that its ring overflowed and conversions were lost
+    uint32_t overflows() const { return this->overflows_; }
+
+    float get_setup_priority() const override;
+    void setup() override;
+    void loop() override;
+    void dump_config() override;
+
+protected:
+    // moves the conversions the driver has ready into samples_, never waits
+    void drain();
+
+    adc1_channel_t channel_;
+    adc_atten_t attenuation_;
+    uint32_t rate_;
+    uint16_t decimation_;
+    bool running_ = false;
+    esp_adc_cal_characteristics_t characteristics_;
+
+    // raw conversions of the sample being decimated
+    uint32_t sum_ = 0;
+    uint16_t summed_ = 0;
+    // decimated samples in V, samples_[i % CONTINUOUS_ADC_SAMPLES] is sample i
+    float samples_[CONTINUOUS_ADC_SAMPLES];
+    // samples decimated since start and up to which read() returned them
+    uint32_t written_ = 0;
+    uint32_t read_ = 0;
+    uint32_t overflows_ = 0;
+};
+
+#endif
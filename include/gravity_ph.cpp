@@ -1,95 +1,210 @@
 #include "gravity_ph.h"
-#include "Matrix.h"
 
 static const char *const TAG = "gravity_ph";
 
-GravityPhSensor::GravityPhSensor(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval) : PollingComponent(updateInterval)
+static const pHCalibrationData FACTORY_CALIBRATION = {
+    PH_CALIBRATION_VERSION,
+    0,
+    0,
+    {10.0, PH_10_DEFAULT_VOLTAGE},
+    {7.0, PH_7_DEFAULT_VOLTAGE},
+    {4.0, PH_4_DEFAULT_VOLTAGE},
+    {},
+    0};
+
+GravityPhSensor::GravityPhSensor(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval)
+    : CalibratedProbe(voltageSensor, updateInterval, TAG, FACTORY_CALIBRATION, PH_CALIBRATION_VERSION, "")
 {
-  this->voltage_sensor = voltageSensor;
+  this->set_stability();
+  this->acidPublish.set_deadband(0);
+  this->neutralPublish.set_deadband(0);
+  this->basePublish.set_deadband(0);
+  this->fitCalibration();
 }
 
 std::vector<esphome::sensor::Sensor *> GravityPhSensor::sensors()
 {
   esphome::App.register_component(this);
 
-  return {this->ph_sensor, this->calibrationData.acid.sensor, this->calibrationData.neutral.sensor, this->calibrationData.base.sensor};
+  return {this->ph_sensor, this->acid_sensor, this->neutral_sensor, this->base_sensor};
 }
 
 void GravityPhSensor::onCalibrationChange()
 {
-  const float x1 = this->calibrationData.acid.mV;
-  const float x2 = this->calibrationData.neutral.mV;
-  const float x3 = this->calibrationData.base.mV;
-  const float y1 = this->calibrationData.acid.pH;
-  const float y2 = this->calibrationData.neutral.pH;
-  const float y3 = this->calibrationData.base.pH;
-
-  this->calibrationData.acid.sensor->publish_state(x1);
-  this->calibrationData.neutral.sensor->publish_state(x2);
-  this->calibrationData.base.sensor->publish_state(x3);
-
-  float array1[3][3] = {
-      {1, x1, x1 * x1},
-      {1, x2, x2 * x2},
-      {1, x3, x3 * x3}};
-  float array2[3][1] =
-      {{y1},
-       {y2},
-       {y3}};
-
-  Matrix A(3, 3, (float *)array1);
-  Matrix B(3, 1, (float *)array2);
-  Matrix C = solveFor(A, B);
-
-  const float c1 = C._entity[0][0];
-  const float c2 = C._entity[1][0];
-  const float c3 = C._entity[2][0];
-  esphome::ESP_LOGI("gravity_ph", "%.2f + %.2f x + %.2f x^2", c1, c2, c3);
-  this->calibration = new esphome::sensor::CalibratePolynomialFilter({c1, c2, c3});
+  if (!this->fitCalibration())
+    esphome::ESP_LOGW(TAG, "calibration points can not support a %s fit, keeping the previous calibration",
+                      calibrationStrategyName(this->strategy));
+  this->publishCalibration();
+  // the filtered level belongs to the previous curve
+  this->phFilter.reset();
+}
+
+void GravityPhSensor::publishCalibration()
+{
+  this->acidPublish.publish(this->acid_sensor, this->calibrationData.acid.mV);
+  this->neutralPublish.publish(this->neutral_sensor, this->calibrationData.neutral.mV);
+  this->basePublish.publish(this->base_sensor, this->calibrationData.base.mV);
+
+  float c[POLYNOMIAL_MAX_COEFFICIENTS] = {0};
+  const uint8_t count = this->calibration.coefficients(c);
+  if (count > 0)
+    esphome::ESP_LOGI(TAG, "%s: %.2f + %.2f x + %.2f x^2", calibrationStrategyName(this->strategy), c[0], c[1], c[2]);
+  else
+    esphome::ESP_LOGI(TAG, "%s calibration", calibrationStrategyName(this->strategy));
+}
+
+bool GravityPhSensor::fitCalibration()
+{
+  AQUARIUM_TIMED(this->timings_.solve);
+  const pHCalibrationPoint &acid = this->calibrationData.acid;
+  const pHCalibrationPoint &neutral = this->calibrationData.neutral;
+  const pHCalibrationPoint &base = this->calibrationData.base;
+
+  if (this->strategy == CalibrationStrategy::LINEAR)
+  {
+    // the two point line through the neutral and acid buffers
+    const float x[2] = {neutral.mV, acid.mV};
+    const float y[2] = {neutral.pH, acid.pH};
+    return this->calibration.fit(this->strategy, x, y, 2);
+  }
+
+  const bool factory = acid.mV == (float)PH_4_DEFAULT_VOLTAGE && acid.pH == 4.0f &&
+                       neutral.mV == (float)PH_7_DEFAULT_VOLTAGE && neutral.pH == 7.0f &&
+                       base.mV == (float)PH_10_DEFAULT_VOLTAGE && base.pH == 10.0f;
+  if (factory && this->strategy == CalibrationStrategy::QUADRATIC)
+  {
+    // the factory calibration has been solved at compile time
+    const float c[3] = {PH_DEFAULT_COEFFICIENTS[0][0], PH_DEFAULT_COEFFICIENTS[1][0], PH_DEFAULT_COEFFICIENTS[2][0]};
+    return this->calibration.setPolynomial(this->strategy, c, 3);
+  }
+
+  float x[CALIBRATION_MAX_POINTS], y[CALIBRATION_MAX_POINTS];
+  const uint8_t n = collectPoints(this->calibrationData, x, y);
+  return this->calibration.fit(this->strategy, x, y, n);
+}
+
+uint8_t GravityPhSensor::collectPoints(const pHCalibrationData &data, float *x, float *y)
+{
+  // acid, neutral, base first: LINEAR and QUADRATIC only look at those
+  const pHCalibrationPoint *named[3] = {&data.acid, &data.neutral, &data.base};
+  uint8_t n = 0;
+  for (const pHCalibrationPoint *point : named)
+  {
+    x[n] = point->mV;
+    y[n++] = point->pH;
+  }
+  for (uint8_t i = 0; i < data.extraCount && i < PH_MAX_EXTRA_POINTS; i++)
+  {
+    x[n] = data.extra[i].mV;
+    y[n++] = data.extra[i].pH;
+  }
+  return n;
+}
+
+void GravityPhSensor::set_calibration_strategy(CalibrationStrategy strategy)
+{
+  this->strategy = strategy;
+  this->fitCalibration();
+}
+
+void GravityPhSensor::set_least_squares_degree(uint8_t degree)
+{
+  this->calibration.setLeastSquaresDegree(degree);
+  this->fitCalibration();
+}
+
+void GravityPhSensor::set_stability(uint8_t window, uint32_t interval, float max_stddev, float max_drift, uint32_t timeout)
+{
+  this->stability.configure(window, interval, max_stddev, max_drift);
+  this->captureTimeout = timeout;
+}
+
+void GravityPhSensor::set_smoothing(float level_noise, float trend_noise, float measurement_noise)
+{
+  this->phFilter.configure(level_noise, trend_noise, measurement_noise);
 }
 
 void GravityPhSensor::setup()
 {
-  this->updateInterval = this->get_update_interval();
+  CalibratedProbe::setup();
   esphome::ESP_LOGI(TAG, "setting up...");
-  this->pref_ = esphome::global_preferences->make_preference<pHCalibrationData>(this->get_object_id_hash());
-  this->pref_.load(&this->calibrationData);
-  if (this->calibrationData.acid.mV != PH_4_VOLTAGE || this->calibrationData.base.mV != PH_8_VOLTAGE || this->calibrationData.neutral.mV != PH_7_LAB_VOLTAGE)
+  if (!this->loadCalibration(this->get_object_id_hash()) && !this->migrateCalibration())
+    esphome::ESP_LOGW(TAG, "no stored calibration, using the factory calibration");
+  this->strategy_pref_ = esphome::global_preferences->make_preference<uint8_t>(this->get_object_id_hash() ^ 0x53545241);
+  uint8_t storedStrategy;
+  if (this->strategy_pref_.load(&storedStrategy))
   {
-    this->onCalibrationChange();
+    if (storedStrategy <= (uint8_t)CalibrationStrategy::LEAST_SQUARES)
+      this->strategy = (CalibrationStrategy)storedStrategy;
+    else
+      esphome::ESP_LOGW(TAG, "stored calibration strategy %u is unknown, using %s", storedStrategy,
+                        calibrationStrategyName(this->strategy));
   }
+  this->onCalibrationChange();
 
-  register_service(&GravityPhSensor::begin_calibration, "begin_calibration");
-  register_service(&GravityPhSensor::end_calibration, "end_calibration");
   register_service(&GravityPhSensor::on_calibration_acid, "calibration_point_acid", {"buffer_ph"});
   register_service(&GravityPhSensor::on_calibration_neutral, "calibration_point_neutral", {"buffer_ph"});
   register_service(&GravityPhSensor::on_calibration_base, "calibration_point_base", {"buffer_ph"});
+  register_service(&GravityPhSensor::on_calibration_point, "calibration_point", {"buffer_ph"});
+  register_service(&GravityPhSensor::on_capture_calibration_point, "capture_calibration_point", {"buffer_ph"});
+  register_service(&GravityPhSensor::on_clear_calibration_points, "clear_calibration_points");
+  register_service(&GravityPhSensor::on_calibration_strategy, "calibration_strategy", {"strategy"});
 }
 
-float GravityPhSensor::get_setup_priority() const
+void GravityPhSensor::dump_config()
 {
-  return esphome::setup_priority::DATA;
+  esphome::ESP_LOGCONFIG(TAG, "Gravity pH:");
+  esphome::ESP_LOGCONFIG(TAG, "  Calibration: %s", calibrationStrategyName(this->strategy));
+  const MatrixArena &arena = calibrationArena();
+  esphome::ESP_LOGCONFIG(TAG, "  Fit arena: %u of %u bytes at most, %u failed allocations", (unsigned)arena.highWater(),
+                         (unsigned)arena.capacity(), (unsigned)arena.failures());
+  if (this->phFilter.enabled())
+    esphome::ESP_LOGCONFIG(TAG, "  Smoothing: level %.5f pH/sqrt(s), trend %.6f pH/s/sqrt(s), reading %.4f pH",
+                           this->phFilter.level_noise(), this->phFilter.trend_noise(), this->phFilter.measurement_noise());
+  esphome::ESP_LOGCONFIG(TAG, "  Publishes: %u sent, %u suppressed", this->phPublish.sent(), this->phPublish.suppressed());
 }
 
-void GravityPhSensor::update()
+float GravityPhSensor::calibrationVoltage()
 {
-  esphome::ESP_LOGI(TAG, "updating");
+  // a source has no last state, take a fresh reading
+  return this->source != nullptr ? this->read_voltage() : this->voltage_sensor->state;
+}
 
-  float V = this->voltage_sensor->state;
-  float pH = this->calibration->new_value(V).value_or(0);
+void GravityPhSensor::process(float V, float variance)
+{
+  AQUARIUM_TIMED(this->timings_.update);
+  this->emit(V, this->calibration.evaluate(V), variance);
+}
 
-  float neutral = (this->calibrationData.neutral.mV - PH_7_LAB_VOLTAGE) / 3.0;
-  float acid = (this->calibrationData.acid.mV - PH_7_LAB_VOLTAGE) / 3.0;
-  float slope = (this->calibrationData.neutral.pH - this->calibrationData.acid.pH) / (neutral - acid);
-  float intercept = this->calibrationData.neutral.pH - slope * neutral;
-  float ph = slope * (V - PH_7_LAB_VOLTAGE) / 3.0 + intercept;
+void GravityPhSensor::publish_reading(float voltage, float ph)
+{
+  // the voltage came from read_voltage(), the sampler knows its spread
+  this->emit(voltage, ph, this->sampler.variance());
+  this->sampleProcessed = true;
+}
 
-  esphome::ESP_LOGD("gravity_ph", "%.2f V | %.2f pH | %.2f cal", V, ph, pH);
+void GravityPhSensor::emit(float V, float ph, float variance)
+{
+  if (this->phFilter.enabled())
+  {
+    // the voltage variance in pH, through the slope of the curve at V
+    const float slope = (this->calibration.evaluate(V + 0.001f) - this->calibration.evaluate(V - 0.001f)) / 0.002f;
+    const float filtered = this->phFilter.step(ph, variance * slope * slope, esphome::millis());
+    AQUARIUM_TIMED(this->timings_.logFormat);
+    esphome::ESP_LOGD(TAG, "%.2f V | %.2f pH | %.2f pH filtered, %+.4f pH/min", V, ph, filtered,
+                      this->phFilter.trend() * 60);
+    ph = filtered;
+  }
+  else
+  {
+    AQUARIUM_TIMED(this->timings_.logFormat);
+    esphome::ESP_LOGD(TAG, "%.2f V | %.2f pH", V, ph);
+  }
 
-  this->ph_sensor->publish_state(ph);
+  this->phPublish.publish(this->ph_sensor, ph);
 }
 
-void GravityPhSensor::begin_calibration()
+void GravityPhSensor::sessionBegan()
 {
   this->voltageUpdateInterval = this->voltage_sensor->get_update_interval();
   this->updateInterval = this->get_update_interval();
@@ -97,32 +212,217 @@ void GravityPhSensor::begin_calibration()
   this->set_update_interval(5000);
 }
 
-void GravityPhSensor::end_calibration()
+void GravityPhSensor::sessionEnded()
 {
+  this->cancelCapture();
   this->set_update_interval(this->updateInterval);
   this->voltage_sensor->set_update_interval(this->voltageUpdateInterval);
 }
 
+bool GravityPhSensor::commitSession()
+{
+  const pHCalibrationData &staged = this->session.staged();
+  float x[CALIBRATION_MAX_POINTS], y[CALIBRATION_MAX_POINTS];
+  const uint8_t n = collectPoints(staged, x, y);
+  const CalibrationCheck check = checkCalibrationPoints(x, y, n, PH_MIN_SLOPE, PH_MAX_SLOPE);
+  if (check != CalibrationCheck::OK)
+  {
+    esphome::ESP_LOGE(TAG, "calibration rejected: %s", calibrationCheckName(check));
+    return false;
+  }
+
+  const pHCalibrationData committed = this->calibrationData;
+  this->calibrationData = staged;
+  if (!this->fitCalibration())
+  {
+    this->calibrationData = committed;
+    esphome::ESP_LOGE(TAG, "calibration rejected: the points can not support a %s fit", calibrationStrategyName(this->strategy));
+    return false;
+  }
+
+  this->saveCalibration();
+  this->publishCalibration();
+  this->phFilter.reset();
+  return true;
+}
+
+bool GravityPhSensor::migrateCalibration()
+{
+  // version 1 has no version or crc, only a different length
+  esphome::ESPPreferenceObject v1 = esphome::global_preferences->make_preference<pHCalibrationDataV1>(this->get_object_id_hash());
+  pHCalibrationDataV1 stored;
+  if (!v1.load(&stored))
+    return false;
+
+  pHCalibrationData data = this->calibrationData;
+  data.base = {stored.base.pH, stored.base.mV};
+  data.neutral = {stored.neutral.pH, stored.neutral.mV};
+  data.acid = {stored.acid.pH, stored.acid.mV};
+  data.extraCount = 0;
+  float x[CALIBRATION_MAX_POINTS], y[CALIBRATION_MAX_POINTS];
+  const uint8_t n = collectPoints(data, x, y);
+  const CalibrationCheck check = checkCalibrationPoints(x, y, n, PH_MIN_SLOPE, PH_MAX_SLOPE);
+  if (check != CalibrationCheck::OK)
+  {
+    esphome::ESP_LOGW(TAG, "version 1 calibration rejected: %s, using the factory calibration", calibrationCheckName(check));
+    return true;
+  }
+
+  this->calibrationData = data;
+  this->saveCalibration();
+  esphome::ESP_LOGW(TAG, "converted the version 1 calibration to version %u", PH_CALIBRATION_VERSION);
+  return true;
+}
+
 void GravityPhSensor::on_calibration_acid(float buffer_pH)
 {
-  this->calibrationData.acid.pH = buffer_pH;
-  this->calibrationData.acid.mV = this->voltage_sensor->state;
-  this->pref_.save(&this->calibrationData);
-  this->onCalibrationChange();
+  this->stage().acid = {buffer_pH, this->calibrationVoltage()};
+  this->staged();
 }
 
 void GravityPhSensor::on_calibration_neutral(float buffer_pH)
 {
-  this->calibrationData.neutral.pH = buffer_pH;
-  this->calibrationData.neutral.mV = this->voltage_sensor->state;
-  this->pref_.save(&this->calibrationData);
-  this->onCalibrationChange();
+  this->stage().neutral = {buffer_pH, this->calibrationVoltage()};
+  this->staged();
 }
 
 void GravityPhSensor::on_calibration_base(float buffer_pH)
 {
-  this->calibrationData.base.pH = buffer_pH;
-  this->calibrationData.base.mV = this->voltage_sensor->state;
-  this->pref_.save(&this->calibrationData);
-  this->onCalibrationChange();
+  this->stage().base = {buffer_pH, this->calibrationVoltage()};
+  this->staged();
+}
+
+void GravityPhSensor::on_calibration_point(float buffer_pH)
+{
+  this->recordPoint(buffer_pH, this->calibrationVoltage());
+}
+
+void GravityPhSensor::recordPoint(float buffer_pH, float voltage)
+{
+  const pHCalibrationPoint point = {buffer_pH, voltage};
+  pHCalibrationData &data = this->stage();
+
+  pHCalibrationPoint *named[3] = {&data.acid, &data.neutral, &data.base};
+  for (pHCalibrationPoint *p : named)
+    if (fabsf(p->pH - buffer_pH) < PH_BUFFER_TOLERANCE)
+    {
+      *p = point;
+      this->staged();
+      return;
+    }
+
+  uint8_t i = 0;
+  while (i < data.extraCount && fabsf(data.extra[i].pH - buffer_pH) >= PH_BUFFER_TOLERANCE)
+    i++;
+
+  if (i < data.extraCount)
+  {
+    data.extra[i] = point;
+  }
+  else if (data.extraCount < PH_MAX_EXTRA_POINTS)
+  {
+    data.extra[data.extraCount++] = point;
+  }
+  else
+  {
+    esphome::ESP_LOGW(TAG, "already %u calibration points, clear them before adding pH %.2f", CALIBRATION_MAX_POINTS, buffer_pH);
+    this->staged(false);
+    return;
+  }
+  this->staged();
+}
+
+void GravityPhSensor::on_capture_calibration_point(float buffer_pH)
+{
+  this->cancelCapture();
+  this->stability.reset();
+  this->captureBuffer = buffer_pH;
+  this->captureStart = esphome::millis();
+  esphome::ESP_LOGI(TAG, "waiting for the probe to settle in pH %.2f", buffer_pH);
+  this->set_interval("capture", this->stability.interval(), [this]()
+                     { this->captureSample(); });
+}
+
+void GravityPhSensor::captureSample()
+{
+  // the detector sees what a reading would: a whole burst when oversampling
+  // is configured, its spread is well below that of a single conversion. A
+  // source that has no sample ready gives no sample this tick.
+  AdcSampleSource adc(this->voltage_sensor);
+  SampleSource *from = this->source != nullptr ? this->source : &adc;
+  float voltage = NAN;
+  if (this->sampler.enabled())
+    voltage = this->sampler.read(from);
+  else if (from->read(&voltage, 1) != 1)
+    voltage = NAN;
+  const uint32_t elapsed = esphome::millis() - this->captureStart;
+  const float buffer = this->captureBuffer;
+
+  if (!std::isnan(voltage) && this->stability.add(voltage))
+  {
+    const float mean = this->stability.mean();
+    const float seconds = elapsed / 1000.0f;
+    this->lastTimeToStable = seconds;
+    this->cancelCapture();
+    esphome::ESP_LOGI(TAG, "pH %.2f stable after %.1f s at %.4f V, sd %.2f mV", buffer, seconds, mean,
+                      this->stability.stddev() * 1000);
+    this->fire_homeassistant_event("esphome.ph_calibration_capture", {
+                                                                         {"buffer_ph", std::to_string(buffer)},
+                                                                         {"stable", "true"},
+                                                                         {"seconds", std::to_string(seconds)},
+                                                                         {"voltage", std::to_string(mean)},
+                                                                     });
+    this->recordPoint(buffer, mean);
+    return;
+  }
+
+  if (elapsed >= this->captureTimeout)
+  {
+    this->cancelCapture();
+    esphome::ESP_LOGW(TAG, "pH %.2f did not settle within %u s, sd %.2f mV, drift %.2f mV/s", buffer,
+                      this->captureTimeout / 1000, this->stability.stddev() * 1000, this->stability.drift() * 1000);
+    this->fire_homeassistant_event("esphome.ph_calibration_capture", {
+                                                                         {"buffer_ph", std::to_string(buffer)},
+                                                                         {"stable", "false"},
+                                                                         {"seconds", std::to_string(elapsed / 1000.0f)},
+                                                                     });
+  }
+}
+
+void GravityPhSensor::cancelCapture()
+{
+  if (std::isnan(this->captureBuffer))
+    return;
+  this->cancel_interval("capture");
+  this->captureBuffer = NAN;
+}
+
+void GravityPhSensor::on_clear_calibration_points()
+{
+  this->stage().extraCount = 0;
+  this->staged();
+}
+
+void GravityPhSensor::on_calibration_strategy(int strategy)
+{
+  if (strategy < (int)CalibrationStrategy::LINEAR || strategy > (int)CalibrationStrategy::LEAST_SQUARES)
+  {
+    esphome::ESP_LOGW(TAG, "unknown calibration strategy %d", strategy);
+    return;
+  }
+  // fit with the new strategy first, the curve stays as it is when that fails
+  const CalibrationStrategy previous = this->strategy;
+  this->strategy = (CalibrationStrategy)strategy;
+  if (!this->fitCalibration())
+  {
+    esphome::ESP_LOGW(TAG, "calibration points can not support a %s fit, keeping %s",
+                      calibrationStrategyName(this->strategy), calibrationStrategyName(previous));
+    this->strategy = previous;
+    return;
+  }
+  const uint8_t stored = strategy;
+  this->strategy_pref_.save(&stored);
+  this->publishCalibration();
+  // the filtered level belongs to the previous curve
+  this->phFilter.reset();
 }
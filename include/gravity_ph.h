@@ -2,12 +2,17 @@
 
 #include <Arduino.h>
 #include "esphome/components/sensor/sensor.h"
-#include "esphome/components/sensor/filter.h"
 #include "esphome/components/adc/adc_sensor.h"
-#include "esphome/components/api/custom_api_device.h"
 #include "esphome/core/preferences.h"
 #include "esphome/core/component.h"
 #include "esphome/core/application.h"
+#include "FixedMatrix.h"
+#include "gravity_probe.h"
+#include "level_trend_filter.h"
+#include "calibration_curve.h"
+#include "Matrix.h"
+#include "publish_policy.h"
+#include "stability_detector.h"
 
 #define PH_8_VOLTAGE 1.1220
 #define PH_6_VOLTAGE 1.4780
@@ -15,53 +20,168 @@
 #define PH_4_VOLTAGE 2.0324
 #define PH_7_LAB_VOLTAGE 1.500
 
+// factory calibration used until the probe has been calibrated
+#define PH_10_DEFAULT_VOLTAGE 1.038646
+#define PH_7_DEFAULT_VOLTAGE 1.442143
+#define PH_4_DEFAULT_VOLTAGE 1.910964
+
+// quadratic coefficients of the factory calibration, solved by the compiler
+constexpr FixedMatrix<3, 1> PH_DEFAULT_COEFFICIENTS = quadraticThrough(
+    PH_4_DEFAULT_VOLTAGE, 4.0, PH_7_DEFAULT_VOLTAGE, 7.0, PH_10_DEFAULT_VOLTAGE, 10.0);
+
 struct pHCalibrationPoint
 {
     float pH;
     float mV;
-    esphome::sensor::Sensor *sensor;
 };
 
+// additional buffers beyond acid, neutral and base, used by the piecewise
+// linear and least-squares strategies
+#define PH_MAX_EXTRA_POINTS (CALIBRATION_MAX_POINTS - 3)
+// buffers whose pH differs by less than this are the same buffer
+#define PH_BUFFER_TOLERANCE 0.05
+// accepted |slope| of a calibration in pH per volt; the factory calibration
+// is 6.9 pH/V
+#define PH_MIN_SLOPE 4.0
+#define PH_MAX_SLOPE 12.5
+
+// version 1 stored sensor pointers next to the points
+#define PH_CALIBRATION_VERSION 2
+
+// The persisted calibration, see calibration_session.h
 struct pHCalibrationData
 {
+    uint16_t version;
+    uint8_t extraCount;
+    uint8_t reserved;
     pHCalibrationPoint base;
     pHCalibrationPoint neutral;
     pHCalibrationPoint acid;
+    pHCalibrationPoint extra[PH_MAX_EXTRA_POINTS];
+    uint32_t crc;
+};
+static_assert(sizeof(pHCalibrationData) == 8 + sizeof(pHCalibrationPoint) * (3 + PH_MAX_EXTRA_POINTS),
+              "pHCalibrationData must not contain padding");
+
+// The version 1 record, as the ESP32 stored it under the same key: each point
+// carried the 32 bit pointer of a sensor, which means nothing after a reboot
+struct pHCalibrationPointV1
+{
+    float pH;
+    float mV;
+    uint32_t sensor;
 };
 
-class GravityPhSensor : public esphome::PollingComponent,
-                        public esphome::sensor::Sensor,
-                        public esphome::api::CustomAPIDevice
+struct pHCalibrationDataV1
+{
+    pHCalibrationPointV1 base;
+    pHCalibrationPointV1 neutral;
+    pHCalibrationPointV1 acid;
+};
+static_assert(sizeof(pHCalibrationDataV1) == 36, "pHCalibrationDataV1 must match the version 1 layout");
+
+class GravityPhSensor : public CalibratedProbe<pHCalibrationData>, public esphome::sensor::Sensor
 {
 private:
-    pHCalibrationData calibrationData = {
-        {10.0, 1.038646, new esphome::sensor::Sensor()},
-        {7.0, 1.442143, new esphome::sensor::Sensor()},
-        {4.0, 1.910964, new esphome::sensor::Sensor()}};
-    esphome::sensor::Filter *calibration = new esphome::sensor::ClampFilter(0.0, 14.0, true);
+    // watches the voltage while a capture waits for the probe to settle
+    StabilityDetector stability;
+    uint32_t captureTimeout = 180000;
+    // pH of the buffer being captured, NAN when no capture runs
+    float captureBuffer = NAN;
+    uint32_t captureStart;
+    float lastTimeToStable = NAN;
+    CalibrationCurve calibration;
+    CalibrationStrategy strategy = CalibrationStrategy::LINEAR;
+    esphome::ESPPreferenceObject strategy_pref_;
+    // the intervals a calibration replaces with faster ones
     uint32_t voltageUpdateInterval;
     uint32_t updateInterval;
-    esphome::ESPPreferenceObject pref_;
 
     esphome::sensor::Sensor *ph_sensor = new esphome::sensor::Sensor();
-    esphome::adc::ADCSensor *voltage_sensor;
+    esphome::sensor::Sensor *acid_sensor = new esphome::sensor::Sensor();
+    esphome::sensor::Sensor *neutral_sensor = new esphome::sensor::Sensor();
+    esphome::sensor::Sensor *base_sensor = new esphome::sensor::Sensor();
+    PublishPolicy phPublish;
+    LevelTrendFilter phFilter;
+    // the calibration sensors only republish when their point moved
+    PublishPolicy acidPublish, neutralPublish, basePublish;
 
+    void process(float V, float variance) override;
+    // logs, filters and publishes a computed reading
+    void emit(float V, float ph, float variance);
+    // the voltage a calibration point records
+    float calibrationVoltage();
     void onCalibrationChange();
+    // publishes the calibration points and logs the fitted curve
+    void publishCalibration();
+    // refits the calibration curve for the current strategy and points
+    bool fitCalibration();
+    // all calibration points of data, returns their count
+    static uint8_t collectPoints(const pHCalibrationData &data, float *x, float *y);
+
+    bool commitSession() override;
+    // samples faster during a calibration
+    void sessionBegan() override;
+    void sessionEnded() override;
+    // loads a version 1 record and saves it as the current version
+    bool migrateCalibration();
+    // stages a point for a buffer of any pH, re-measuring the point for that buffer when there is one
+    void recordPoint(float buffer_ph, float voltage);
+    void captureSample();
+    void cancelCapture();
 
 public:
     GravityPhSensor(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval = 15000);
 
     std::vector<esphome::sensor::Sensor *> sensors();
 
-    float get_setup_priority() const override;
+    // publish the level of a LevelTrendFilter instead of every reading, for
+    // noise levels see LevelTrendFilter::configure; the variance of each
+    // reading comes from its oversampling burst when there is one
+    void set_smoothing(float level_noise = 0.0001, float trend_noise = 0.000005, float measurement_noise = 0.005);
+    // the filter behind set_smoothing, e.g. for its trend (pH/s)
+    const LevelTrendFilter &filter() const { return this->phFilter; }
+
+    // how pH is derived from the calibration points, see CalibrationStrategy
+    void set_calibration_strategy(CalibrationStrategy strategy);
+    // polynomial degree (1 or 2) of the LEAST_SQUARES strategy
+    void set_least_squares_degree(uint8_t degree);
+
+    // publishes a pH computed elsewhere from voltage, e.g. by a
+    // WaterQualityFrame; the next poll is skipped
+    void publish_reading(float voltage, float ph);
+    // the curve voltages are converted with
+    const CalibrationCurve &calibration_curve() const { return this->calibration; }
+
+    // capture_calibration_point samples the voltage every interval ms and
+    // records the point once the last window samples have a standard
+    // deviation <= max_stddev (V) and drift <= max_drift (V/s), or gives up
+    // after timeout ms. Each sample is an oversampling burst; the default
+    // max_stddev is meant for bursts, a single ESP32 conversion scatters by
+    // several mV, so without oversampling raise it to about 0.008
+    void set_stability(uint8_t window = 40, uint32_t interval = 250, float max_stddev = 0.002,
+                       float max_drift = 0.0002, uint32_t timeout = 180000);
+
+    // seconds the last capture took to become stable, NAN before the first
+    float last_time_to_stable() const { return this->lastTimeToStable; }
+
+    // decides which pH values reach the API, publishes everything unless configured
+    PublishPolicy &publish_policy() { return this->phPublish; }
 
     void setup() override;
 
-    void update() override;
+    void dump_config() override;
 
-    void begin_calibration();
-    void end_calibration();
     void on_calibration_acid(float buffer_ph = 4.0);
     void on_calibration_neutral(float buffer_ph = 7.0);
     void on_calibration_base(float buffer_ph = 10.0);
+    // API service, records a buffer of any pH; re-measures the point for that buffer when there is one
+    void on_calibration_point(float buffer_ph);
+    // API service, records a buffer of any pH once the probe has settled in it,
+    // fires an esphome.ph_calibration_capture event with the outcome
+    void on_capture_calibration_point(float buffer_ph);
+    // API service, forgets the points recorded by on_calibration_point
+    void on_clear_calibration_points();
+    // API service, strategy is the numeric CalibrationStrategy value
+    void on_calibration_strategy(int strategy);
 };
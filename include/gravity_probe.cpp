@@ -0,0 +1,80 @@
+#include "gravity_probe.h"
+
+GravityProbe::GravityProbe(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval, const char *tag)
+    : PollingComponent(updateInterval), tag_(tag), voltage_sensor(voltageSensor)
+{
+}
+
+float GravityProbe::get_setup_priority() const
+{
+    return esphome::setup_priority::DATA;
+}
+
+void GravityProbe::set_oversampling(uint8_t samples, SampleReduction reduction, float trim)
+{
+    this->sampler.configure(samples, reduction, trim);
+}
+
+void GravityProbe::set_event_driven(bool enabled, uint32_t fallback_interval)
+{
+    this->eventDriven = enabled;
+    this->fallbackInterval = fallback_interval;
+}
+
+void GravityProbe::setup()
+{
+#ifdef AQUARIUM_INSTRUMENTATION
+    this->voltage_sensor->add_on_state_callback([this](float)
+                                                { this->sampleTime_ = esphome::micros(); });
+#endif
+    if (this->eventDriven)
+    {
+        this->voltage_sensor->add_on_state_callback([this](float v)
+                                                    { this->onVoltage(v); });
+        this->set_update_interval(this->fallbackInterval);
+    }
+}
+
+void GravityProbe::update()
+{
+    if (this->sampleProcessed)
+    {
+        // event driven and the voltage sensor is delivering, nothing to catch up on
+        this->sampleProcessed = false;
+        return;
+    }
+
+    esphome::ESP_LOGI(this->tag_, "updating...");
+    // a burst is converted right now, otherwise the reading is the ADC's last state
+    AQUARIUM_RECORD(this->timings_.sampleAge, this->sampler.enabled() ? 0 : esphome::micros() - this->sampleTime_);
+    const float v = this->read_voltage();
+    this->process(v, this->sampler.variance());
+}
+
+void GravityProbe::onVoltage(float v)
+{
+    AQUARIUM_RECORD(this->timings_.sampleAge, 0);
+    // the sample is fresh; a configured burst still replaces the single conversion
+    if (this->sampler.enabled())
+    {
+        const float burst = this->read_voltage();
+        this->process(burst, this->sampler.variance());
+    }
+    else
+        this->process(v, NAN);
+    this->sampleProcessed = true;
+}
+
+float GravityProbe::read_voltage()
+{
+    if (this->source != nullptr)
+        return this->sampler.read(this->source);
+    return this->sampler.read(this->voltage_sensor);
+}
+
+void GravityProbe::process_reading(float voltage)
+{
+    AQUARIUM_RECORD(this->timings_.sampleAge, 0);
+    this->process(voltage, NAN);
+    this->sampleProcessed = true;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <Arduino.h>
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/components/api/custom_api_device.h"
+#include "esphome/core/component.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "burst_sampler.h"
+#include "calibration_session.h"
+#include "instrumentation.h"
+#include "sample_source.h"
+
+// The acquisition the Gravity probes share: where a reading's voltage comes
+// from (the ADC sensor, an oversampling burst or a SampleSource), when it is
+// taken (every poll, or on every sample of the ADC sensor) and readings taken
+// elsewhere. A probe implements process() to turn a voltage into its value.
+class GravityProbe : public esphome::PollingComponent
+{
+public:
+    float get_setup_priority() const override;
+
+    // take a burst of `samples` ADC conversions on every update and reduce them
+    // to one reading, samples <= 1 uses the ADC sensor's last state
+    void set_oversampling(uint8_t samples, SampleReduction reduction = SampleReduction::MEDIAN, float trim = 0.2);
+
+    // take the voltage from source instead of the ADC sensor, a block of the
+    // oversampling size per reading
+    void set_sample_source(SampleSource *source) { this->source = source; }
+
+    // compute and publish right after every new sample of the voltage sensor;
+    // polling continues every fallback_interval ms in case samples stop arriving
+    void set_event_driven(bool enabled, uint32_t fallback_interval = 60000);
+
+    // a reading taken elsewhere, e.g. by a ProbeScheduler; the next poll is skipped
+    void process_reading(float voltage);
+    // a reading from the sample source, or the ADC sensor's
+    float read_voltage();
+
+#ifdef AQUARIUM_INSTRUMENTATION
+    // hot path timings, feed them to a TimingReport to publish them
+    ComponentTimings &timings() { return this->timings_; }
+#endif
+
+    // subscribes to the voltage sensor, call it from the probe's setup()
+    void setup() override;
+
+    void update() override;
+
+protected:
+    // tag is the log tag of the probe
+    GravityProbe(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval, const char *tag);
+
+    // computes, logs and publishes the reading of voltage v; variance is that
+    // of v (V^2), NAN when unknown
+    virtual void process(float v, float variance) = 0;
+    void onVoltage(float v);
+
+    const char *tag_;
+    esphome::adc::ADCSensor *voltage_sensor;
+    BurstSampler sampler;
+    // replaces the ADC sensor as the origin of voltages when set
+    SampleSource *source = nullptr;
+    bool eventDriven = false;
+    uint32_t fallbackInterval;
+    // a voltage sample was processed since the last poll
+    bool sampleProcessed = false;
+#ifdef AQUARIUM_INSTRUMENTATION
+    ComponentTimings timings_;
+    // micros() of the voltage sensor's last state
+    uint32_t sampleTime_ = 0;
+#endif
+};
+
+// A probe with a persisted calibration record T (see calibration_session.h)
+// that is changed through API services. Outside of a calibration every change
+// is validated and committed on its own; between <prefix>begin_calibration
+// and <prefix>end_calibration the changes are staged and committed together.
+template <typename T>
+class CalibratedProbe : public GravityProbe, public esphome::api::CustomAPIDevice
+{
+public:
+    // API service, stages calibration points in RAM until end_calibration
+    void begin_calibration()
+    {
+        if (this->calibrating)
+        {
+            esphome::ESP_LOGW(this->tag_, "calibration already in progress");
+            return;
+        }
+        this->session.begin(this->calibrationData);
+        this->calibrating = true;
+        this->sessionBegan();
+    }
+
+    // API service, validates the staged points and commits them with one flash write
+    void end_calibration()
+    {
+        if (!this->calibrating)
+        {
+            esphome::ESP_LOGW(this->tag_, "no calibration in progress");
+            return;
+        }
+        if (this->session.changes() > 0)
+        {
+            if (!this->commitSession())
+            {
+                esphome::ESP_LOGW(this->tag_, "re-measure the points and end again, or abort the calibration");
+                return;
+            }
+            esphome::ESP_LOGI(this->tag_, "calibration committed, %u points measured", this->session.changes());
+        }
+        this->endSession();
+    }
+
+    // API service, discards the staged points
+    void abort_calibration()
+    {
+        if (!this->calibrating)
+        {
+            esphome::ESP_LOGW(this->tag_, "no calibration in progress");
+            return;
+        }
+        esphome::ESP_LOGI(this->tag_, "calibration aborted, %u staged points discarded", this->session.changes());
+        this->endSession();
+    }
+
+    // subscribes to the voltage sensor and registers the session services,
+    // call it from the probe's setup()
+    void setup() override
+    {
+        GravityProbe::setup();
+        const std::string prefix = this->prefix_;
+        this->register_service(&CalibratedProbe::begin_calibration, prefix + "begin_calibration");
+        this->register_service(&CalibratedProbe::end_calibration, prefix + "end_calibration");
+        this->register_service(&CalibratedProbe::abort_calibration, prefix + "abort_calibration");
+    }
+
+protected:
+    // prefix is put before the names of the calibration services
+    CalibratedProbe(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval, const char *tag,
+                    const T &factory, uint16_t version, const char *prefix)
+        : GravityProbe(voltageSensor, updateInterval, tag), calibrationData(factory), version_(version), prefix_(prefix)
+    {
+    }
+
+    // validates and fits the staged points and makes them the calibration,
+    // false keeps the committed calibration; saveCalibration() persists it
+    virtual bool commitSession() = 0;
+    // the probe enters and leaves a calibration, e.g. to sample faster
+    virtual void sessionBegan() {}
+    virtual void sessionEnded() {}
+
+    // loads the record persisted under key, false when none was stored; a
+    // damaged record or one of another version keeps the factory calibration
+    bool loadCalibration(uint32_t key)
+    {
+        this->pref_ = esphome::global_preferences->make_preference<T>(key);
+        T stored;
+        if (!this->pref_.load(&stored))
+            return false;
+        if (calibrationRecordValid(stored, this->version_))
+            this->calibrationData = stored;
+        else
+            esphome::ESP_LOGW(this->tag_, "stored calibration is damaged or from another version, using the factory calibration");
+        return true;
+    }
+
+    void saveCalibration()
+    {
+        sealCalibrationRecord(this->calibrationData, this->version_);
+        this->pref_.save(&this->calibrationData);
+    }
+
+    // the record a calibration service changes, opening a session for this
+    // one change when none is open; finish with staged()
+    T &stage()
+    {
+        if (!this->session.open())
+            this->session.begin(this->calibrationData);
+        return this->session.staged();
+    }
+
+    // outside of begin_calibration a change is committed immediately
+    void staged(bool changed = true)
+    {
+        if (changed)
+            this->session.changed();
+        if (this->calibrating)
+        {
+            esphome::ESP_LOGI(this->tag_, "%u points staged, %send_calibration applies them", this->session.changes(),
+                              this->prefix_);
+            return;
+        }
+        if (changed)
+            this->commitSession();
+        this->session.close();
+    }
+
+    void endSession()
+    {
+        this->sessionEnded();
+        this->session.close();
+        this->calibrating = false;
+    }
+
+    T calibrationData;
+    // points measured since begin_calibration, committed by end_calibration
+    CalibrationSession<T> session;
+    // begin_calibration opened the session; otherwise every point commits on its own
+    bool calibrating = false;
+    esphome::ESPPreferenceObject pref_;
+    uint16_t version_;
+    const char *prefix_;
+};
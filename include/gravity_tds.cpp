@@ -2,22 +2,58 @@
 
 static const char *const TAG = "gravity_tds";
 
-GravityTdsSensor::GravityTdsSensor(esphome::adc::ADCSensor *voltageSensor, Sensor *tempSensor, uint32_t updateInterval) : PollingComponent(updateInterval)
+GravityTdsSensor::GravityTdsSensor(esphome::adc::ADCSensor *voltageSensor, Sensor *tempSensor, uint32_t updateInterval)
+    : GravityProbe(voltageSensor, updateInterval, TAG)
 {
   this->temperature_sensor = tempSensor;
-  this->voltage_sensor = voltageSensor;
 };
 
-float GravityTdsSensor::get_setup_priority() const
+void GravityTdsSensor::setup()
 {
-  return esphome::setup_priority::DATA;
+  GravityProbe::setup();
+  esphome::ESP_LOGI(TAG, "setting up...");
+  this->pref_ = esphome::global_preferences->make_preference<TdsCalibrationData>(this->get_object_id_hash());
+  TdsCalibrationData stored;
+  if (this->pref_.load(&stored))
+  {
+    if (calibrationRecordValid(stored, TDS_CALIBRATION_VERSION))
+      this->kValue = stored.kValue;
+    else
+      esphome::ESP_LOGW(TAG, "stored calibration is damaged or from another version, using K %.3f", this->kValue);
+  }
+  else if (!this->migrateCalibration())
+    esphome::ESP_LOGI(TAG, "no stored calibration, using K %.3f", this->kValue);
 }
 
-void GravityTdsSensor::setup()
+bool GravityTdsSensor::migrateCalibration()
 {
-  esphome::ESP_LOGI(TAG, "setting up...");
-  this->pref_ = esphome::global_preferences->make_preference<float>(this->get_object_id_hash());
-  this->pref_.load(&this->kValue);
+  // version 1 stored the K value alone under the same key
+  esphome::ESPPreferenceObject v1 = esphome::global_preferences->make_preference<float>(this->get_object_id_hash());
+  float kValue;
+  if (!v1.load(&kValue))
+    return false;
+
+  // the K value absorbed the compensation of the converted temperature it was
+  // calibrated at; that temperature is not known, take the reference
+  const float calibrated = (TDS_REFERENCE_TEMPERATURE - 32.0f) / 1.8f;
+  this->kValue = kValue * tdsTemperatureCompensation(TDS_REFERENCE_TEMPERATURE) / tdsTemperatureCompensation(calibrated);
+  esphome::ESP_LOGW(TAG, "K value %.3f was calibrated with temperatures run through an F to C conversion, rescaled "
+                         "to %.3f assuming a calibration at %.0f C; recalibrate for full accuracy",
+                    kValue, this->kValue, TDS_REFERENCE_TEMPERATURE);
+  this->saveCalibration();
+  return true;
+}
+
+void GravityTdsSensor::saveCalibration()
+{
+  TdsCalibrationData data = {0, 0, this->kValue, 0};
+  sealCalibrationRecord(data, TDS_CALIBRATION_VERSION);
+  this->pref_.save(&data);
+}
+
+void GravityTdsSensor::set_smoothing(float level_noise, float trend_noise, float measurement_noise)
+{
+  this->tdsFilter.configure(level_noise, trend_noise, measurement_noise);
 }
 
 std::vector<esphome::sensor::Sensor *> GravityTdsSensor::sensors()
@@ -27,32 +63,71 @@ std::vector<esphome::sensor::Sensor *> GravityTdsSensor::sensors()
   return {this->tds_sensor};
 }
 
-void GravityTdsSensor::update()
+void GravityTdsSensor::dump_config()
 {
-  esphome::ESP_LOGI(TAG, "updating...");
-  float temperature = ftoc(this->temperature_sensor->state);
+  esphome::ESP_LOGCONFIG(TAG, "Gravity TDS:");
+  esphome::ESP_LOGCONFIG(TAG, "  K value: %.3f", this->kValue);
+  if (this->temperature_sensor == nullptr)
+    esphome::ESP_LOGCONFIG(TAG, "  Temperature: none, not compensated");
+  if (this->tdsFilter.enabled())
+    esphome::ESP_LOGCONFIG(TAG, "  Smoothing: level %.3f ppm/sqrt(s), trend %.4f ppm/s/sqrt(s), reading %.2f ppm",
+                           this->tdsFilter.level_noise(), this->tdsFilter.trend_noise(), this->tdsFilter.measurement_noise());
+  esphome::ESP_LOGCONFIG(TAG, "  Publishes: %u sent, %u suppressed", this->tdsPublish.sent(), this->tdsPublish.suppressed());
+}
 
-  float v = this->voltage_sensor->state;
-  float ec = (133.42 * v * v * v - 255.86 * v * v + 857.39 * v) * this->kValue;
-  esphome::ESP_LOGD("gravity_tds", "%.2f V? | %.2f EC", v, ec);
-  float ec25 = ec / (1.0 + 0.02 * (temperature - 25.0)); // temperature compensation
-  float tds = ec25 * TdsFactor;
+void GravityTdsSensor::process(float v, float variance)
+{
+  AQUARIUM_TIMED(this->timings_.update);
+  float temperature = this->temperature_celsius();
+  // the scale only needs refolding when the temperature or the K value moved
+  if (temperature != this->kernelTemperature || this->kValue != this->kernelK)
+  {
+    this->kernel.setCompensation(this->kValue, temperature);
+    this->kernelK = this->kValue;
+    this->kernelTemperature = temperature;
+  }
+  this->emit(v, this->kernel.convert(v), temperature, variance);
+}
 
-  esphome::ESP_LOGD("gravity_tds", "%.2f ppm | %.2f C", tds, temperature);
-  tds_sensor->publish_state(tds);
+void GravityTdsSensor::publish_reading(float voltage, float tds, float temperature)
+{
+  // the voltage came from read_voltage(), the sampler knows its spread
+  this->emit(voltage, tds, temperature, this->sampler.variance());
+  this->sampleProcessed = true;
 }
 
-void GravityTdsSensor::calibrate(float buffer_ppm)
+void GravityTdsSensor::emit(float v, float tds, float temperature, float variance)
 {
-  float temperature = ftoc(this->temperature_sensor->state);
-  float v = this->voltage_sensor->state;
+  if (this->tdsFilter.enabled())
+  {
+    // the voltage variance in ppm at this temperature
+    const float slope = tdsScale(this->kValue, temperature) * tdsRawEcSlope(v);
+    const float filtered = this->tdsFilter.step(tds, variance * slope * slope, esphome::millis());
+    AQUARIUM_TIMED(this->timings_.logFormat);
+    esphome::ESP_LOGD(TAG, "%.2f V | %.2f ppm | %.2f C | %.2f ppm filtered, %+.3f ppm/min", v, tds, temperature,
+                      filtered, this->tdsFilter.trend() * 60);
+    tds = filtered;
+  }
+  else
+  {
+    AQUARIUM_TIMED(this->timings_.logFormat);
+    esphome::ESP_LOGD(TAG, "%.2f V | %.2f ppm | %.2f C", v, tds, temperature);
+  }
+  this->tdsPublish.publish(this->tds_sensor, tds);
+}
 
-  float bufferedEC = buffer_ppm * (1.0 + 0.02 * (temperature - 25.0));
-  float ec = (133.42 * v * v * v - 255.86 * v * v + 857.39 * v);
+void GravityTdsSensor::calibrate(float buffer_ppm)
+{
+  float temperature = this->temperature_celsius();
+  float v = this->read_voltage();
 
-  float kValue = bufferedEC / ec;
+  float bufferedEC = buffer_ppm * tdsTemperatureCompensation(temperature);
+  float ec = tdsRawEc(v);
 
-  this->pref_.save(&kValue);
+  this->kValue = bufferedEC / ec;
+  this->saveCalibration();
+  // the filtered level belongs to the previous K value
+  this->tdsFilter.reset();
 }
 
 // void GravityTDS::ecCalibration(uint8_t mode)
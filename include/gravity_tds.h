@@ -6,10 +6,26 @@
 #include "esphome/core/preferences.h"
 #include "esphome/core/application.h"
 #include "esphome/core/component.h"
+#include "gravity_probe.h"
+#include "level_trend_filter.h"
+#include "tds_kernel.h"
+#include "publish_policy.h"
+#include "calibration_session.h"
 
-#define TdsFactor 0.5 // tds = ec / 2
+// version 1 was the bare K value, calibrated against the temperature sensor's
+// Celsius state run through a Fahrenheit to Celsius conversion
+#define TDS_CALIBRATION_VERSION 2
 
-class GravityTdsSensor : public esphome::PollingComponent, public esphome::sensor::Sensor
+// The persisted calibration, see calibration_session.h
+struct TdsCalibrationData
+{
+    uint16_t version;
+    uint16_t reserved;
+    float kValue;
+    uint32_t crc;
+};
+
+class GravityTdsSensor : public GravityProbe, public esphome::sensor::Sensor
 {
 
 private:
@@ -19,24 +35,54 @@ private:
     float adcRange = 1024;  // 1024 for 10bit ADC;4096 for 12bit ADC
     esphome::sensor::Sensor *temperature_sensor;
     esphome::sensor::Sensor *tds_sensor = new esphome::sensor::Sensor();
-    esphome::sensor::Sensor *voltage_sensor;
+    PublishPolicy tdsPublish;
+    LevelTrendFilter tdsFilter;
     esphome::ESPPreferenceObject pref_;
+    TdsKernel kernel;
+    // the K value and temperature the kernel's scale was folded for
+    float kernelK = NAN;
+    float kernelTemperature = NAN;
 
-    float ftoc(float temp)
-    {
-        return (temp - 32.0) / 1.8;
-    }
+    void process(float v, float variance) override;
+    // logs, filters and publishes a computed reading
+    void emit(float v, float tds, float temperature, float variance);
+    // loads a version 1 K value and rescales it for Celsius temperatures
+    bool migrateCalibration();
+    void saveCalibration();
 
 public:
+    // tempSensor reports the water temperature in C; it may be nullptr, TDS
+    // is then not compensated for temperature
     GravityTdsSensor(esphome::adc::ADCSensor *voltageSensor, esphome::sensor::Sensor *tempSensor, uint32_t updateInterval = 15000);
 
     void calibrate(float buffer_ppm = 707.0);
 
+    // publish the level of a LevelTrendFilter instead of every reading, for
+    // noise levels see LevelTrendFilter::configure. The filter follows TDS
+    // compensated to 25 C, so a change of water temperature does not show up
+    // as a trend; the variance of each reading comes from its oversampling burst
+    void set_smoothing(float level_noise = 0.005, float trend_noise = 0.0003, float measurement_noise = 0.5);
+    // the filter behind set_smoothing, e.g. for its trend (ppm/s)
+    const LevelTrendFilter &filter() const { return this->tdsFilter; }
+
+    // publishes a TDS computed elsewhere from voltage at temperature (C), e.g.
+    // by a WaterQualityFrame; the next poll is skipped
+    void publish_reading(float voltage, float tds, float temperature);
+    // the water temperature the conversion is compensated for, C
+    float temperature_celsius()
+    {
+        if (this->temperature_sensor == nullptr)
+            return TDS_REFERENCE_TEMPERATURE;
+        return this->temperature_sensor->state;
+    }
+    float k_value() const { return this->kValue; }
+
     std::vector<esphome::sensor::Sensor *> sensors();
 
-    float get_setup_priority() const override;
+    // decides which TDS values reach the API, publishes everything unless configured
+    PublishPolicy &publish_policy() { return this->tdsPublish; }
 
     void setup() override;
 
-    void update() override;
+    void dump_config() override;
 };
@@ -0,0 +1,179 @@
+#include "gravity_tss.h"
+#include <cmath>
+
+static const char *const TAG = "gravity_tss";
+
+static const TssCalibrationData FACTORY_CALIBRATION = {
+    TSS_CALIBRATION_VERSION,
+    3,
+    0,
+    {TSS_DEFAULT_C0, TSS_DEFAULT_C1, TSS_DEFAULT_C2},
+    {},
+    0};
+
+GravityTssSensor::GravityTssSensor(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval)
+    : CalibratedProbe(voltageSensor, updateInterval, TAG, FACTORY_CALIBRATION, TSS_CALIBRATION_VERSION, "tss_")
+{
+  this->applyCalibration();
+}
+
+void GravityTssSensor::setup()
+{
+  CalibratedProbe::setup();
+  esphome::ESP_LOGI(TAG, "setting up...");
+  this->loadCalibration(this->get_object_id_hash());
+  this->applyCalibration();
+
+  register_service(&GravityTssSensor::on_calibration_point, "tss_calibration_point", {"standard_ntu"});
+  register_service(&GravityTssSensor::on_clear_calibration_points, "tss_clear_calibration_points");
+  register_service(&GravityTssSensor::on_calibration_coefficients, "tss_calibration_coefficients", {"c0", "c1", "c2"});
+}
+
+std::vector<esphome::sensor::Sensor *> GravityTssSensor::sensors()
+{
+  esphome::App.register_component(this);
+
+  return {this->tss_sensor};
+}
+
+void GravityTssSensor::dump_config()
+{
+  esphome::ESP_LOGCONFIG(TAG, "Gravity TSS:");
+  const float *c = this->calibrationData.coefficients;
+  esphome::ESP_LOGCONFIG(TAG, "  Curve: %.3f + %.3f v + %.3f v^2, %u points", c[0], c[1], c[2], this->calibrationData.pointCount);
+  esphome::ESP_LOGCONFIG(TAG, "  Publishes: %u sent, %u suppressed", this->tssPublish.sent(), this->tssPublish.suppressed());
+}
+
+void GravityTssSensor::process(float v, float variance)
+{
+  AQUARIUM_TIMED(this->timings_.update);
+  this->emit(v, this->curve.evaluate(v));
+}
+
+void GravityTssSensor::publish_reading(float voltage, float tss)
+{
+  this->emit(voltage, tss);
+  this->sampleProcessed = true;
+}
+
+void GravityTssSensor::emit(float v, float tss)
+{
+  {
+    AQUARIUM_TIMED(this->timings_.logFormat);
+    esphome::ESP_LOGD(TAG, "%.3f V | %.1f NTU", v, tss);
+  }
+  this->tssPublish.publish(this->tss_sensor, tss);
+}
+
+void GravityTssSensor::applyCalibration()
+{
+  this->curve.set(this->calibrationData.coefficients, this->calibrationData.coefficientCount);
+}
+
+uint8_t GravityTssSensor::collectPoints(const TssCalibrationData &data, float *x, float *y)
+{
+  uint8_t n = 0;
+  for (; n < data.pointCount && n < CALIBRATION_MAX_POINTS; n++)
+  {
+    x[n] = data.points[n].volts;
+    y[n] = data.points[n].ntu;
+  }
+  return n;
+}
+
+bool GravityTssSensor::fitPoints(TssCalibrationData &data)
+{
+  float x[CALIBRATION_MAX_POINTS], y[CALIBRATION_MAX_POINTS];
+  const uint8_t n = collectPoints(data, x, y);
+
+  // a line through two standards, the best quadratic through more
+  CalibrationCurve fitted;
+  fitted.setLeastSquaresDegree(2);
+  if (!fitted.fit(n == 2 ? CalibrationStrategy::LINEAR : CalibrationStrategy::LEAST_SQUARES, x, y, n))
+    return false;
+
+  float coefficients[POLYNOMIAL_MAX_COEFFICIENTS] = {0};
+  data.coefficientCount = fitted.coefficients(coefficients);
+  for (uint8_t i = 0; i < POLYNOMIAL_MAX_COEFFICIENTS; i++)
+    data.coefficients[i] = coefficients[i];
+  return data.coefficientCount > 0;
+}
+
+bool GravityTssSensor::commitSession()
+{
+  TssCalibrationData staged = this->session.staged();
+  if (staged.pointCount >= 2)
+  {
+    float x[CALIBRATION_MAX_POINTS], y[CALIBRATION_MAX_POINTS];
+    const uint8_t n = collectPoints(staged, x, y);
+    const CalibrationCheck check = checkCalibrationPoints(x, y, n, TSS_MIN_SLOPE, TSS_MAX_SLOPE);
+    if (check != CalibrationCheck::OK)
+    {
+      esphome::ESP_LOGE(TAG, "calibration rejected: %s", calibrationCheckName(check));
+      return false;
+    }
+    if (!fitPoints(staged))
+    {
+      esphome::ESP_LOGE(TAG, "calibration rejected: the points can not support a fit");
+      return false;
+    }
+  }
+  // a single point is kept until a second one allows a fit
+
+  this->calibrationData = staged;
+  this->saveCalibration();
+  this->applyCalibration();
+  const float *c = this->calibrationData.coefficients;
+  esphome::ESP_LOGI(TAG, "curve %.3f + %.3f v + %.3f v^2 from %u points", c[0], c[1], c[2], this->calibrationData.pointCount);
+  return true;
+}
+
+void GravityTssSensor::on_calibration_point(float standard_ntu)
+{
+  const TssCalibrationPoint point = {standard_ntu, this->read_voltage()};
+  TssCalibrationData &data = this->stage();
+
+  uint8_t i = 0;
+  while (i < data.pointCount && fabsf(data.points[i].ntu - standard_ntu) >= TSS_STANDARD_TOLERANCE)
+    i++;
+
+  if (i < data.pointCount)
+  {
+    data.points[i] = point;
+  }
+  else if (data.pointCount < CALIBRATION_MAX_POINTS)
+  {
+    data.points[data.pointCount++] = point;
+  }
+  else
+  {
+    esphome::ESP_LOGW(TAG, "already %u calibration points, clear them before adding %.1f NTU", CALIBRATION_MAX_POINTS, standard_ntu);
+    this->staged(false);
+    return;
+  }
+  this->staged();
+}
+
+void GravityTssSensor::on_clear_calibration_points()
+{
+  TssCalibrationData &data = this->stage();
+  data.pointCount = 0;
+  data.coefficientCount = 3;
+  data.coefficients[0] = TSS_DEFAULT_C0;
+  data.coefficients[1] = TSS_DEFAULT_C1;
+  data.coefficients[2] = TSS_DEFAULT_C2;
+  data.coefficients[3] = 0;
+  this->staged();
+}
+
+void GravityTssSensor::on_calibration_coefficients(float c0, float c1, float c2)
+{
+  TssCalibrationData &data = this->stage();
+  data.pointCount = 0;
+  data.coefficientCount = 3;
+  data.coefficients[0] = c0;
+  data.coefficients[1] = c1;
+  data.coefficients[2] = c2;
+  data.coefficients[3] = 0;
+  this->staged();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/preferences.h"
+#include "esphome/core/application.h"
+#include "esphome/core/component.h"
+#include "calibration_curve.h"
+#include "gravity_probe.h"
+#include "polynomial_calibration.h"
+#include "publish_policy.h"
+
+// factory curve of the turbidity probe, TSS (NTU) = c0 + c1 v + c2 v^2
+#define TSS_DEFAULT_C0 2960.1f
+#define TSS_DEFAULT_C1 1305.46f
+#define TSS_DEFAULT_C2 -819.891f
+
+// standards whose turbidity differs by less than this are the same standard
+#define TSS_STANDARD_TOLERANCE 1.0
+// accepted |slope| of a calibration in NTU per volt
+#define TSS_MIN_SLOPE 10.0
+#define TSS_MAX_SLOPE 50000.0
+
+#define TSS_CALIBRATION_VERSION 1
+
+struct TssCalibrationPoint
+{
+    float ntu;
+    float volts;
+};
+
+// The persisted calibration, see calibration_session.h. coefficients are the
+// curve in use; they are refitted whenever two or more points are committed,
+// or set directly by the tss_calibration_coefficients service.
+struct TssCalibrationData
+{
+    uint16_t version;
+    uint8_t coefficientCount;
+    uint8_t pointCount;
+    float coefficients[POLYNOMIAL_MAX_COEFFICIENTS];
+    TssCalibrationPoint points[CALIBRATION_MAX_POINTS];
+    uint32_t crc;
+};
+static_assert(sizeof(TssCalibrationData) == 8 + sizeof(float) * POLYNOMIAL_MAX_COEFFICIENTS +
+                                                sizeof(TssCalibrationPoint) * CALIBRATION_MAX_POINTS,
+              "TssCalibrationData must not contain padding");
+
+class GravityTssSensor : public CalibratedProbe<TssCalibrationData>, public esphome::sensor::Sensor
+{
+private:
+    PolynomialCalibration curve;
+
+    esphome::sensor::Sensor *tss_sensor = new esphome::sensor::Sensor();
+    PublishPolicy tssPublish;
+
+    // the variance is not used, TSS is not smoothed
+    void process(float v, float variance) override;
+    // logs and publishes a computed reading
+    void emit(float v, float tss);
+    // installs the coefficients of calibrationData
+    void applyCalibration();
+    // the calibration points of data as voltages and turbidities, returns their count
+    static uint8_t collectPoints(const TssCalibrationData &data, float *x, float *y);
+    // fits the coefficients of data to its points, false when they can not support a fit
+    static bool fitPoints(TssCalibrationData &data);
+
+    bool commitSession() override;
+
+public:
+    GravityTssSensor(esphome::adc::ADCSensor *voltageSensor, uint32_t updateInterval = 15000);
+
+    std::vector<esphome::sensor::Sensor *> sensors();
+
+    // publishes a TSS computed elsewhere from voltage, e.g. by a
+    // WaterQualityFrame; the next poll is skipped
+    void publish_reading(float voltage, float tss);
+    // the curve voltages are converted with
+    const PolynomialCalibration &calibration_curve() const { return this->curve; }
+
+    // decides which TSS values reach the API, publishes everything unless configured
+    PublishPolicy &publish_policy() { return this->tssPublish; }
+
+    void setup() override;
+
+    void dump_config() override;
+
+    // API service, records the probe voltage in a standard of standard_ntu;
+    // re-measures the point for that standard when there is one
+    void on_calibration_point(float standard_ntu);
+    // API service, forgets the points and returns to the factory curve
+    void on_clear_calibration_points();
+    // API service, installs a quadratic computed elsewhere; the points are forgotten
+    void on_calibration_coefficients(float c0, float c1, float c2);
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Fixed-memory time series history with a raw tier and min/max/avg rollups at
+// 1 min, 15 min and 1 h. Values are quantized to 16 bits over a configured
+// range and timestamps are stored as 16 bit deltas to the previous record, so
+// a raw record takes 4 bytes and a rollup record 8. Insert and rollup are O(1);
+// every tier is a ring buffer that overwrites its oldest record when full.
+//
+// Times are in seconds on any monotonic clock. Gaps longer than 65535 s
+// between two records of one tier are shortened to 65535 s.
+//
+// This header has no ESPHome dependencies so it can be tested on the host.
+
+enum class HistoryTier : uint8_t
+{
+    RAW = 0,
+    MINUTE = 1,
+    QUARTER_HOUR = 2,
+    HOUR = 3,
+};
+
+#define HISTORY_TIERS 4
+// quantized value of a missing (NaN) sample
+#define HISTORY_MISSING 0xFFFF
+
+// maps values in [min, max] onto 0..65534
+class HistoryQuantizer
+{
+public:
+    HistoryQuantizer(float min = 0, float max = 1) { this->setRange(min, max); }
+
+    void setRange(float min, float max)
+    {
+        this->offset_ = min;
+        this->scale_ = max > min ? (max - min) / (HISTORY_MISSING - 1) : 1;
+    }
+
+    uint16_t quantize(float value) const
+    {
+        if (std::isnan(value))
+            return HISTORY_MISSING;
+        const float q = (value - this->offset_) / this->scale_ + 0.5f;
+        if (q <= 0)
+            return 0;
+        if (q >= HISTORY_MISSING - 1)
+            return HISTORY_MISSING - 1;
+        return (uint16_t)q;
+    }
+
+    float value(uint16_t q) const { return q == HISTORY_MISSING ? NAN : this->offset_ + q * this->scale_; }
+
+    float offset() const { return this->offset_; }
+    float scale() const { return this->scale_; }
+
+protected:
+    float offset_;
+    float scale_;
+};
+
+struct HistoryRawRecord
+{
+    uint16_t dt;
+    uint16_t value;
+};
+
+struct HistoryRollupRecord
+{
+    uint16_t dt;
+    uint16_t avg;
+    uint16_t min;
+    uint16_t max;
+};
+
+// Ring of records whose times are deltas to the previous record. Only the
+// time of the oldest and the newest record are kept in full.
+template <typename R, uint16_t N>
+class HistoryRing
+{
+    static_assert(N > 0, "HistoryRing needs room for at least one record");
+
+public:
+    void push(uint32_t time, R record)
+    {
+        if (this->count_ == 0)
+        {
+            record.dt = 0;
+            this->firstTime_ = time;
+            this->lastTime_ = time;
+        }
+        else
+        {
+            const uint32_t gap = time - this->lastTime_;
+            record.dt = gap > 0xFFFF ? 0xFFFF : (uint16_t)gap;
+            this->lastTime_ += record.dt;
+        }
+
+        if (this->count_ == N)
+        {
+            // the second oldest becomes the oldest, its delta moves the start
+            this->head_ = this->head_ + 1 == N ? 0 : this->head_ + 1;
+            this->count_--;
+            this->firstTime_ += this->records_[this->head_].dt;
+        }
+
+        uint16_t tail = this->head_ + this->count_;
+        if (tail >= N)
+            tail -= N;
+        this->records_[tail] = record;
+        this->count_++;
+    }
+
+    // calls f(time, record) for every record, oldest first
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        uint32_t time = this->firstTime_;
+        uint16_t index = this->head_;
+        for (uint16_t i = 0; i < this->count_; i++)
+        {
+            const R &record = this->records_[index];
+            if (i > 0)
+                time += record.dt;
+            f(time, record);
+            index = index + 1 == N ? 0 : index + 1;
+        }
+    }
+
+    uint16_t size() const { return this->count_; }
+    static constexpr uint16_t capacity() { return N; }
+    uint32_t firstTime() const { return this->firstTime_; }
+    uint32_t lastTime() const { return this->lastTime_; }
+
+protected:
+    R records_[N];
+    uint16_t head_ = 0;
+    uint16_t count_ = 0;
+    uint32_t firstTime_ = 0;
+    uint32_t lastTime_ = 0;
+};
+
+template <uint16_t RAW, uint16_t MINUTE, uint16_t QUARTER_HOUR, uint16_t HOUR>
+class HistoryStore
+{
+public:
+    HistoryStore(float min = 0, float max = 1) : quantizer_(min, max) {}
+
+    // range of values that can be stored, others are clamped; clears nothing,
+    // so set it before the first insert
+    void setRange(float min, float max) { this->quantizer_.setRange(min, max); }
+    const HistoryQuantizer &quantizer() const { return this->quantizer_; }
+
+    void insert(uint32_t time, float value)
+    {
+        this->raw_.push(time, HistoryRawRecord{0, this->quantizer_.quantize(value)});
+        if (std::isnan(value))
+            return;
+
+        this->accumulate(this->accumulators_[0], this->minute_, 60, time, value);
+        this->accumulate(this->accumulators_[1], this->quarterHour_, 900, time, value);
+        this->accumulate(this->accumulators_[2], this->hour_, 3600, time, value);
+    }
+
+    // Calls f(time, min, max, avg) for every record of tier with from <= time <= to,
+    // oldest first. Raw records report their value as min, max and avg; rollup
+    // records are stamped with the start of their period. Periods still being
+    // accumulated are not reported.
+    template <typename F>
+    void read(HistoryTier tier, uint32_t from, uint32_t to, F &&f) const
+    {
+        const HistoryQuantizer &q = this->quantizer_;
+        auto rollup = [&](uint32_t time, const HistoryRollupRecord &r)
+        {
+            if (time >= from && time <= to)
+                f(time, q.value(r.min), q.value(r.max), q.value(r.avg));
+        };
+
+        switch (tier)
+        {
+        case HistoryTier::RAW:
+            this->raw_.forEach([&](uint32_t time, const HistoryRawRecord &r)
+                               {
+                if (time >= from && time <= to)
+                {
+                    const float v = q.value(r.value);
+                    f(time, v, v, v);
+                } });
+            break;
+        case HistoryTier::MINUTE:
+            this->minute_.forEach(rollup);
+            break;
+        case HistoryTier::QUARTER_HOUR:
+            this->quarterHour_.forEach(rollup);
+            break;
+        case HistoryTier::HOUR:
+            this->hour_.forEach(rollup);
+            break;
+        }
+    }
+
+    uint16_t size(HistoryTier tier) const
+    {
+        switch (tier)
+        {
+        case HistoryTier::RAW:
+            return this->raw_.size();
+        case HistoryTier::MINUTE:
+            return this->minute_.size();
+        case HistoryTier::QUARTER_HOUR:
+            return this->quarterHour_.size();
+        case HistoryTier::HOUR:
+            return this->hour_.size();
+        }
+        return 0;
+    }
+
+protected:
+    struct Accumulator
+    {
+        uint32_t period = 0;
+        float min = 0;
+        float max = 0;
+        float sum = 0;
+        uint16_t count = 0;
+    };
+
+    template <typename Ring>
+    void accumulate(Accumulator &acc, Ring &ring, uint32_t length, uint32_t time, float value)
+    {
+        const uint32_t period = time / length;
+        if (acc.count > 0 && period != acc.period)
+        {
+            const HistoryQuantizer &q = this->quantizer_;
+            ring.push(acc.period * length, HistoryRollupRecord{0, q.quantize(acc.sum / acc.count), q.quantize(acc.min), q.quantize(acc.max)});
+            acc.count = 0;
+        }
+
+        if (acc.count == 0)
+        {
+            acc.period = period;
+            acc.min = value;
+            acc.max = value;
+            acc.sum = 0;
+        }
+        acc.min = value < acc.min ? value : acc.min;
+        acc.max = value > acc.max ? value : acc.max;
+        acc.sum += value;
+        acc.count++;
+    }
+
+    HistoryQuantizer quantizer_;
+    HistoryRing<HistoryRawRecord, RAW> raw_;
+    HistoryRing<HistoryRollupRecord, MINUTE> minute_;
+    HistoryRing<HistoryRollupRecord, QUARTER_HOUR> quarterHour_;
+    HistoryRing<HistoryRollupRecord, HOUR> hour_;
+    Accumulator accumulators_[3];
+};
+
+// 1 h of 15 s samples, 6 h of minutes, 4 days of quarter hours and 14 days of
+// hours: 9.6 kB per series. The raw tier only spans an hour when every reading
+// is recorded, see WaterHistory::add_series
+typedef HistoryStore<240, 360, 384, 336> WaterHistoryStore;
@@ -0,0 +1,107 @@
+#include "instrumentation.h"
+
+#ifdef AQUARIUM_INSTRUMENTATION
+
+#include "esphome/core/application.h"
+
+void TimingStats::record(uint32_t value)
+{
+    this->count_++;
+    this->sum_ += value;
+    if (value < this->min_)
+        this->min_ = value;
+    if (value > this->max_)
+        this->max_ = value;
+
+    uint16_t &bucket = this->buckets_[bucketOf(value)];
+    if (bucket == UINT16_MAX)
+    {
+        // halve the histogram rather than let one bucket saturate, the shape stays
+        for (uint16_t &b : this->buckets_)
+            b = (b + 1) / 2;
+    }
+    bucket++;
+}
+
+void TimingStats::reset()
+{
+    *this = TimingStats();
+}
+
+uint32_t TimingStats::percentile(float p) const
+{
+    uint32_t total = 0;
+    for (uint16_t b : this->buckets_)
+        total += b;
+    if (total == 0)
+        return 0;
+
+    const float target = p * total;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < TIMING_BUCKETS; i++)
+    {
+        seen += this->buckets_[i];
+        if (seen >= target)
+        {
+            const uint32_t limit = bucketLimit(i);
+            return limit < this->max_ ? limit : this->max_;
+        }
+    }
+    return this->max_;
+}
+
+uint8_t TimingStats::bucketOf(uint32_t value)
+{
+    if (value < 4)
+        return value;
+    // e = floor(log2 value), then the two bits below the leading one
+    const int e = 31 - __builtin_clz(value);
+    return 4 * (e - 1) + ((value >> (e - 2)) & 3);
+}
+
+uint32_t TimingStats::bucketLimit(uint8_t bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    const int e = bucket / 4 + 1;
+    const uint64_t limit = ((uint64_t)(5 + bucket % 4) << (e - 2)) - 1;
+    return limit > UINT32_MAX ? UINT32_MAX : (uint32_t)limit;
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    const uint32_t cycles = esphome::arch_get_cpu_cycle_count() - this->start_;
+    this->stats_.record((uint32_t)((uint64_t)cycles * 1000000000 / esphome::arch_get_cpu_freq_hz()));
+}
+
+std::vector<esphome::sensor::Sensor *> TimingReport::add(TimingStats *stats, float scale)
+{
+    Entry entry = {stats, scale, new esphome::sensor::Sensor(), new esphome::sensor::Sensor(),
+                   new esphome::sensor::Sensor(), new esphome::sensor::Sensor()};
+    this->entries_.push_back(entry);
+    if (this->entries_.size() == 1)
+        esphome::App.register_component(this);
+    return {entry.min, entry.mean, entry.max, entry.p99};
+}
+
+float TimingReport::get_setup_priority() const
+{
+    return esphome::setup_priority::LATE;
+}
+
+void TimingReport::update()
+{
+    for (Entry &entry : this->entries_)
+    {
+        TimingStats &stats = *entry.stats;
+        if (stats.count() == 0)
+            continue;
+        entry.min->publish_state(stats.min() * entry.scale);
+        entry.mean->publish_state(stats.mean() * entry.scale);
+        entry.max->publish_state(stats.max() * entry.scale);
+        entry.p99->publish_state(stats.percentile(0.99f) * entry.scale);
+        stats.reset();
+    }
+}
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+// Timing of the hot paths, compiled in only when AQUARIUM_INSTRUMENTATION is
+// defined, e.g. with
+//
+//   esphome:
+//     platformio_options:
+//       build_flags: -DAQUARIUM_INSTRUMENTATION
+//
+// Without it AQUARIUM_TIMED and AQUARIUM_RECORD expand to nothing and none of
+// the classes below exist, so the firmware carries no trace of it.
+
+#ifdef AQUARIUM_INSTRUMENTATION
+
+#include <cstdint>
+#include <vector>
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+
+// log-linear buckets: 4 per power of two, covering all of uint32_t
+#define TIMING_BUCKETS 124
+
+// Min, mean, max and percentiles of recorded values. Percentiles come from a
+// log-linear histogram and are accurate to the bucket width, 25% of the
+// value. Recording is O(1) and never allocates.
+class TimingStats
+{
+public:
+    void record(uint32_t value);
+    void reset();
+
+    uint32_t count() const { return this->count_; }
+    uint32_t min() const { return this->count_ > 0 ? this->min_ : 0; }
+    uint32_t max() const { return this->max_; }
+    float mean() const { return this->count_ > 0 ? (float)this->sum_ / this->count_ : 0; }
+    // upper bound of the bucket holding the p quantile (0 < p <= 1), capped at max()
+    uint32_t percentile(float p) const;
+
+protected:
+    static uint8_t bucketOf(uint32_t value);
+    static uint32_t bucketLimit(uint8_t bucket);
+
+    uint32_t count_ = 0;
+    uint32_t min_ = UINT32_MAX;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+    uint16_t buckets_[TIMING_BUCKETS] = {0};
+};
+
+// Per component timings. Durations are in ns, the sample age in us.
+struct ComponentTimings
+{
+    // computing and publishing one reading
+    TimingStats update;
+    // age of the ADC reading the computation used
+    TimingStats sampleAge;
+    // refitting the calibration
+    TimingStats solve;
+    // formatting and emitting the per-reading log line
+    TimingStats logFormat;
+};
+
+// records the time from construction to destruction in ns
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(TimingStats &stats) : stats_(stats), start_(esphome::arch_get_cpu_cycle_count()) {}
+    ~ScopedTimer();
+
+protected:
+    TimingStats &stats_;
+    uint32_t start_;
+};
+
+// Publishes min, mean, max and p99 of a set of TimingStats as diagnostic
+// sensors every update interval, then starts the next interval afresh.
+class TimingReport : public esphome::PollingComponent
+{
+public:
+    explicit TimingReport(uint32_t updateInterval = 60000) : PollingComponent(updateInterval) {}
+
+    // sensors for min, mean, max and p99 of stats; values are multiplied by
+    // scale, the default turns ns into us
+    std::vector<esphome::sensor::Sensor *> add(TimingStats *stats, float scale = 0.001);
+
+    float get_setup_priority() const override;
+    void update() override;
+
+protected:
+    struct Entry
+    {
+        TimingStats *stats;
+        float scale;
+        esphome::sensor::Sensor *min;
+        esphome::sensor::Sensor *mean;
+        esphome::sensor::Sensor *max;
+        esphome::sensor::Sensor *p99;
+    };
+    std::vector<Entry> entries_;
+};
+
+#define AQUARIUM_TIMING_CONCAT_(a, b) a##b
+#define AQUARIUM_TIMING_NAME_(line) AQUARIUM_TIMING_CONCAT_(aquarium_timer_, line)
+// times the rest of the enclosing scope into stats
+#define AQUARIUM_TIMED(stats) ScopedTimer AQUARIUM_TIMING_NAME_(__LINE__)(stats)
+#define AQUARIUM_RECORD(stats, value) (stats).record(value)
+
+#else
+
+#define AQUARIUM_TIMED(stats)
+#define AQUARIUM_RECORD(stats, value)
+
+#endif
@@ -0,0 +1,90 @@
+#include "level_trend_filter.h"
+
+void LevelTrendFilter::configure(float level_noise, float trend_noise, float measurement_noise)
+{
+    this->levelNoise_ = level_noise * level_noise;
+    this->trendNoise_ = trend_noise * trend_noise;
+    this->measurementNoise_ = measurement_noise * measurement_noise;
+    this->enabled_ = true;
+    this->reset();
+}
+
+void LevelTrendFilter::reset()
+{
+    this->x_ = {};
+    this->P_ = {};
+    this->initialized_ = false;
+    this->jump_ = 0;
+}
+
+void LevelTrendFilter::predict(float dt)
+{
+    if (!this->initialized_ || dt <= 0)
+        return;
+
+    const FixedMatrix<2, 2> F = {{{1, dt},
+                                  {0, 1}}};
+    // the trend takes a random walk of trendNoise_ per second, which the level
+    // integrates; the level adds one of its own
+    const float q = this->trendNoise_;
+    const float dt2 = dt * dt;
+    const FixedMatrix<2, 2> Q = {{{this->levelNoise_ * dt + q * dt2 * dt / 3, q * dt2 / 2},
+                                  {q * dt2 / 2, q * dt}}};
+
+    this->x_ = F * this->x_;
+    this->P_ = F * this->P_ * transpose(F) + Q;
+}
+
+float LevelTrendFilter::update(float value, float variance)
+{
+    // a failed reading leaves the state alone
+    if (std::isnan(value))
+        return value;
+
+    float r = this->measurementNoise_;
+    if (!std::isnan(variance) && variance > r)
+        r = variance;
+
+    // only the level is measured, H = [1 0]
+    const float innovation = value - this->x_[0][0];
+    const float s = this->P_[0][0] + r;
+
+    int8_t jump = 0;
+    if (this->initialized_ && innovation * innovation > LEVEL_TREND_JUMP_SIGMAS * LEVEL_TREND_JUMP_SIGMAS * s)
+        jump = innovation > 0 ? 1 : -1;
+    if (jump != 0 && jump == this->jump_)
+    {
+        this->initialized_ = false;
+        jump = 0;
+    }
+    this->jump_ = jump;
+
+    if (!this->initialized_)
+    {
+        // the level is the reading; the trend is unknown, one reading
+        // standard deviation per second lets the next reading set it
+        this->x_ = {{{value}, {0}}};
+        this->P_ = {{{r, 0},
+                     {0, r}}};
+        this->initialized_ = true;
+        return value;
+    }
+
+    const FixedMatrix<2, 1> K = {{{this->P_[0][0] / s},
+                                  {this->P_[1][0] / s}}};
+    const FixedMatrix<1, 2> HP = {{{this->P_[0][0], this->P_[0][1]}}};
+
+    this->x_ += K * innovation;
+    this->P_ -= K * HP;
+    // keep P symmetric against rounding
+    this->P_[0][1] = this->P_[1][0] = (this->P_[0][1] + this->P_[1][0]) / 2;
+    return this->level();
+}
+
+float LevelTrendFilter::step(float value, float variance, uint32_t now)
+{
+    if (this->initialized_)
+        this->predict((now - this->last_) / 1000.0f);
+    this->last_ = now;
+    return this->update(value, variance);
+}
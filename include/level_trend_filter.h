@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include "FixedMatrix.h"
+
+// two readings in a row this many standard deviations off the prediction, on
+// the same side, restart the filter from the reading
+#define LEVEL_TREND_JUMP_SIGMAS 4
+
+// A Kalman filter that follows a slowly moving reading, such as pH or TDS,
+// with a level and a trend (units per second) as its state.
+//
+// Between readings the level moves on with the trend; how much the level and
+// the trend may change on their own is the process noise. Each reading comes
+// with its variance, which is how the filter decides between trusting the
+// reading and trusting its prediction. Noisy readings are smoothed like a long
+// moving average, but a dosing change shows up as a trend after a few readings
+// instead of dragging the average along for the length of the window. A
+// sudden jump, such as the probe moving to another tank or buffer, restarts
+// the filter rather than being followed slowly.
+//
+// The state and covariance are FixedMatrix members, a step never allocates.
+class LevelTrendFilter
+{
+public:
+    // level_noise: how far the level may wander beyond the trend, units per
+    // sqrt(s); trend_noise: how fast the trend may change, units/s per
+    // sqrt(s); measurement_noise: standard deviation of a reading that comes
+    // without a variance, and the least one assumed for any reading.
+    // Enables the filter and forgets the state.
+    void configure(float level_noise, float trend_noise, float measurement_noise);
+
+    bool enabled() const { return this->enabled_; }
+
+    // forgets the state, the next reading starts the filter afresh
+    void reset();
+
+    // advances the state by dt seconds
+    void predict(float dt);
+    // corrects the state with a reading of the given variance, NAN for the
+    // configured measurement noise; returns the filtered level, or NAN for a
+    // NAN reading
+    float update(float value, float variance = NAN);
+    // predicts up to now (ms) and updates with the reading
+    float step(float value, float variance, uint32_t now);
+
+    // true once a reading has been taken since the last reset
+    bool initialized() const { return this->initialized_; }
+    float level() const { return this->x_[0][0]; }
+    // units per second
+    float trend() const { return this->x_[1][0]; }
+    float level_stddev() const { return std::sqrt(this->P_[0][0]); }
+    float trend_stddev() const { return std::sqrt(this->P_[1][1]); }
+
+    float level_noise() const { return std::sqrt(this->levelNoise_); }
+    float trend_noise() const { return std::sqrt(this->trendNoise_); }
+    float measurement_noise() const { return std::sqrt(this->measurementNoise_); }
+
+protected:
+    // level and trend
+    FixedMatrix<2, 1> x_ = {};
+    FixedMatrix<2, 2> P_ = {};
+    // the noises are kept as variances (densities for the process noise)
+    float levelNoise_ = 0;
+    float trendNoise_ = 0;
+    float measurementNoise_ = 0;
+    bool enabled_ = false;
+    bool initialized_ = false;
+    // side of the prediction the last reading fell on when it was beyond
+    // LEVEL_TREND_JUMP_SIGMAS, 0 when it was within
+    int8_t jump_ = 0;
+    // millis() of the last step
+    uint32_t last_ = 0;
+};
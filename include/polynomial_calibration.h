@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// enough for the cubic TDS curve
+#define POLYNOMIAL_MAX_COEFFICIENTS 4
+
+// Evaluates y = c[0] + c[1] x + c[2] x^2 + ... with Horner's method in float.
+//
+// The coefficients are stored inline in two banks. set() fills the inactive
+// bank and then publishes it with a single atomic store, so evaluate() always
+// sees one complete set of coefficients, old or new, and neither side touches
+// the heap. There must only be one writer.
+class PolynomialCalibration
+{
+public:
+    PolynomialCalibration() = default;
+    PolynomialCalibration(const float *coefficients, uint8_t count) { this->set(coefficients, count); }
+
+    // false, and nothing changes, when count is 0 or above POLYNOMIAL_MAX_COEFFICIENTS
+    bool set(const float *coefficients, uint8_t count)
+    {
+        if (count == 0 || count > POLYNOMIAL_MAX_COEFFICIENTS)
+            return false;
+
+        const uint8_t next = this->active_.load(std::memory_order_relaxed) ^ 1;
+        Bank &bank = this->banks_[next];
+        for (uint8_t i = 0; i < count; i++)
+            bank.c[i] = coefficients[i];
+        bank.count = count;
+        this->active_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    float evaluate(float x) const
+    {
+        const Bank &bank = this->banks_[this->active_.load(std::memory_order_acquire)];
+        float y = bank.c[bank.count - 1];
+        for (int i = bank.count - 2; i >= 0; i--)
+            y = y * x + bank.c[i];
+        return y;
+    }
+
+    // evaluates n values with one set of coefficients, x and y may be the same array
+    void evaluate(const float *x, float *y, size_t n) const
+    {
+        const Bank &bank = this->banks_[this->active_.load(std::memory_order_acquire)];
+        for (size_t k = 0; k < n; k++)
+        {
+            float v = bank.c[bank.count - 1];
+            for (int i = bank.count - 2; i >= 0; i--)
+                v = v * x[k] + bank.c[i];
+            y[k] = v;
+        }
+    }
+
+    // copies the active coefficients into out, returns their count
+    uint8_t get(float *out) const
+    {
+        const Bank &bank = this->banks_[this->active_.load(std::memory_order_acquire)];
+        for (uint8_t i = 0; i < bank.count; i++)
+            out[i] = bank.c[i];
+        return bank.count;
+    }
+
+protected:
+    struct Bank
+    {
+        float c[POLYNOMIAL_MAX_COEFFICIENTS] = {0};
+        uint8_t count = 1;
+    };
+
+    Bank banks_[2];
+    std::atomic<uint8_t> active_{0};
+};
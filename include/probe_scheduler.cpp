@@ -0,0 +1,191 @@
+#include "probe_scheduler.h"
+#include <cmath>
+
+static const char *const TAG = "probe_scheduler";
+
+bool ProbeTimeline::add(uint32_t settle, uint8_t samples, uint32_t spacing)
+{
+    if (this->count_ >= PROBE_MAX_CHANNELS)
+        return false;
+    if (samples < 1)
+        samples = 1;
+    this->slots_[this->count_++] = {settle, spacing, samples > PROBE_MAX_SAMPLES ? (uint8_t)PROBE_MAX_SAMPLES : samples};
+    return true;
+}
+
+void ProbeTimeline::restart()
+{
+    this->converted_ = 0;
+    this->current_ = this->count_ > 0 ? ProbeAction{ProbeStep::POWER_ON, 0, 0} : ProbeAction{ProbeStep::PUBLISH, 0, 0};
+}
+
+void ProbeTimeline::advance()
+{
+    ProbeAction &a = this->current_;
+    switch (a.step)
+    {
+    case ProbeStep::POWER_ON:
+        a.step = ProbeStep::CONVERT;
+        a.at += this->slots_[a.channel].settle;
+        this->converted_ = 0;
+        break;
+    case ProbeStep::CONVERT:
+        if (++this->converted_ < this->slots_[a.channel].samples)
+            a.at += this->slots_[a.channel].spacing;
+        else
+            a.step = ProbeStep::POWER_OFF;
+        break;
+    case ProbeStep::POWER_OFF:
+        if (a.channel + 1 < this->count_)
+        {
+            a.step = ProbeStep::POWER_ON;
+            a.channel++;
+        }
+        else
+        {
+            a.step = ProbeStep::PUBLISH;
+            a.channel = 0;
+        }
+        break;
+    case ProbeStep::PUBLISH:
+    case ProbeStep::DONE:
+        a.step = ProbeStep::DONE;
+        break;
+    }
+}
+
+uint32_t ProbeTimeline::duration() const
+{
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < this->count_; i++)
+        total += this->slots_[i].settle + (this->slots_[i].samples - 1) * this->slots_[i].spacing;
+    return total;
+}
+
+int ProbeScheduler::add_channel(esphome::adc::ADCSensor *adc, std::function<void(float)> &&consumer, uint32_t settle,
+                                uint8_t samples, uint32_t spacing, SampleReduction reduction, float trim)
+{
+    const uint8_t index = this->timeline_.channels();
+    if (!this->timeline_.add(settle, samples, spacing))
+    {
+        esphome::ESP_LOGE(TAG, "no room for another channel, at most %u", PROBE_MAX_CHANNELS);
+        return -1;
+    }
+    Channel &channel = this->channels_[index];
+    channel.adc = adc;
+    channel.consumer = std::move(consumer);
+    channel.reduction = reduction;
+    channel.trim = trim < 0 ? 0 : (trim >= 0.5 ? 0.49 : trim);
+    channel.count = 0;
+    return index;
+}
+
+void ProbeScheduler::set_power(int channel, std::function<void(bool)> &&power)
+{
+    if (channel >= 0 && channel < this->timeline_.channels())
+        this->channels_[channel].power = std::move(power);
+}
+
+float ProbeScheduler::get_setup_priority() const
+{
+    return esphome::setup_priority::DATA;
+}
+
+void ProbeScheduler::setup()
+{
+    // probes that can be switched start off, each cycle powers them in turn
+    for (uint8_t i = 0; i < this->timeline_.channels(); i++)
+        if (this->channels_[i].power)
+            this->channels_[i].power(false);
+}
+
+void ProbeScheduler::dump_config()
+{
+    esphome::ESP_LOGCONFIG(TAG, "Probe scheduler:");
+    esphome::ESP_LOGCONFIG(TAG, "  Channels: %u, cycle %u ms of %u ms", this->timeline_.channels(),
+                           this->timeline_.duration(), this->get_update_interval());
+    esphome::ESP_LOGCONFIG(TAG, "  Cycles: %u, overruns %u", this->cycles_, this->overruns_);
+}
+
+void ProbeScheduler::update()
+{
+    if (this->running_)
+    {
+        this->overruns_++;
+        esphome::ESP_LOGW(TAG, "cycle of %u ms still running, skipping this one", this->timeline_.duration());
+        return;
+    }
+    this->running_ = true;
+    this->cycleStart_ = esphome::millis();
+    for (uint8_t i = 0; i < this->timeline_.channels(); i++)
+        this->channels_[i].count = 0;
+    this->timeline_.restart();
+    this->run();
+}
+
+void ProbeScheduler::run()
+{
+    while (true)
+    {
+        const ProbeAction &action = this->timeline_.current();
+        const uint32_t elapsed = esphome::millis() - this->cycleStart_;
+        if (action.at > elapsed)
+        {
+            this->set_timeout("step", action.at - elapsed, [this]()
+                              { this->run(); });
+            return;
+        }
+
+        Channel &channel = this->channels_[action.channel];
+        switch (action.step)
+        {
+        case ProbeStep::POWER_ON:
+            if (channel.power)
+                channel.power(true);
+            break;
+        case ProbeStep::CONVERT:
+        {
+            const float v = channel.adc->sample();
+            if (!std::isnan(v) && channel.count < PROBE_MAX_SAMPLES)
+                channel.samples[channel.count++] = v;
+            break;
+        }
+        case ProbeStep::POWER_OFF:
+            if (channel.power)
+                channel.power(false);
+            break;
+        case ProbeStep::PUBLISH:
+            this->publish();
+            break;
+        case ProbeStep::DONE:
+            this->running_ = false;
+            this->cycles_++;
+            return;
+        }
+        this->timeline_.advance();
+    }
+}
+
+void ProbeScheduler::publish()
+{
+    float readings[PROBE_MAX_CHANNELS];
+    const uint8_t n = this->timeline_.channels();
+    for (uint8_t i = 0; i < n; i++)
+    {
+        Channel &channel = this->channels_[i];
+        if (channel.count == 0)
+            readings[i] = NAN;
+        else if (channel.reduction == SampleReduction::MEDIAN)
+            readings[i] = medianOf(channel.samples, channel.count);
+        else
+            readings[i] = trimmedMeanOf(channel.samples, channel.count, channel.trim);
+    }
+
+    // compute everything first, then let the voltages out
+    for (uint8_t i = 0; i < n; i++)
+        if (!std::isnan(readings[i]) && this->channels_[i].consumer)
+            this->channels_[i].consumer(readings[i]);
+    for (uint8_t i = 0; i < n; i++)
+        if (!std::isnan(readings[i]))
+            this->channels_[i].adc->publish_state(readings[i]);
+}
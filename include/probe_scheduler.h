@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/core/application.h"
+#include "esphome/core/component.h"
+#include "burst_sampler.h"
+
+// channels of one scheduler, and conversions per channel and cycle
+#define PROBE_MAX_CHANNELS 8
+#define PROBE_MAX_SAMPLES 16
+
+enum class ProbeStep : uint8_t
+{
+    // switch the probe of the channel on, its settle time starts
+    POWER_ON,
+    // take one conversion of the channel
+    CONVERT,
+    // switch the probe of the channel off again
+    POWER_OFF,
+    // all channels are converted, compute and publish them together
+    PUBLISH,
+    // the cycle is over
+    DONE,
+};
+
+struct ProbeAction
+{
+    ProbeStep step;
+    uint8_t channel;
+    // ms after the start of the cycle
+    uint32_t at;
+};
+
+// The timeline of one measurement cycle, without any ESPHome dependency.
+//
+// Channels take turns: a channel is powered, left to settle, converted
+// `samples` times `spacing` ms apart and powered off before the next channel
+// is powered, so no two probes are ever in the water electrically at the same
+// time. After the last channel every reading is published in one pass.
+//
+//   | on ~settle~ c c c off | on ~settle~ c c off | publish
+class ProbeTimeline
+{
+public:
+    // false when all PROBE_MAX_CHANNELS are taken
+    bool add(uint32_t settle, uint8_t samples, uint32_t spacing);
+
+    uint8_t channels() const { return this->count_; }
+
+    // back to the first action of a cycle
+    void restart();
+    const ProbeAction &current() const { return this->current_; }
+    // moves to the next action, current() is DONE at the end of the cycle
+    void advance();
+
+    // ms from the start of a cycle until PUBLISH
+    uint32_t duration() const;
+
+protected:
+    struct Slot
+    {
+        uint32_t settle;
+        uint32_t spacing;
+        uint8_t samples;
+    };
+
+    Slot slots_[PROBE_MAX_CHANNELS];
+    uint8_t count_ = 0;
+    ProbeAction current_ = {ProbeStep::DONE, 0, 0};
+    // conversions of the current channel taken so far
+    uint8_t converted_ = 0;
+};
+
+// Owns the conversions of several probes on one board. Instead of every ADC
+// sensor and every probe component polling on its own timer, the scheduler
+// runs one cycle per update interval along a ProbeTimeline and hands all
+// readings to their consumers in one batch.
+//
+// The ADC sensors should be configured with `update_interval: never`; the
+// scheduler converts them and publishes the reduced voltage on them after the
+// consumers ran. The consumers are typically process_reading() of
+// GravityPhSensor and GravityTdsSensor. Those must not be event driven then,
+// and their own update interval only acts as a fallback, so make it longer
+// than the scheduler's.
+class ProbeScheduler : public esphome::PollingComponent
+{
+public:
+    explicit ProbeScheduler(uint32_t updateInterval = 15000) : PollingComponent(updateInterval) {}
+
+    // adds a channel: settle ms after power on, then samples conversions
+    // spacing ms apart, reduced to one reading handed to consumer (trim is
+    // that of a TRIMMED_MEAN reduction, as in BurstSampler). Returns the
+    // channel number, or -1 when the scheduler is full.
+    int add_channel(esphome::adc::ADCSensor *adc, std::function<void(float)> &&consumer, uint32_t settle = 100,
+                    uint8_t samples = 8, uint32_t spacing = 5, SampleReduction reduction = SampleReduction::MEDIAN,
+                    float trim = 0.2);
+    // switches the probe of a channel, e.g. an isolator or a relay; without it the probe stays on
+    void set_power(int channel, std::function<void(bool)> &&power);
+
+    float get_setup_priority() const override;
+    void setup() override;
+    void dump_config() override;
+    void update() override;
+
+    uint32_t cycles() const { return this->cycles_; }
+    // cycles that were still running when the next one was due
+    uint32_t overruns() const { return this->overruns_; }
+
+protected:
+    // performs every action that is due and schedules the next one
+    void run();
+    void publish();
+
+    struct Channel
+    {
+        esphome::adc::ADCSensor *adc;
+        std::function<void(float)> consumer;
+        std::function<void(bool)> power;
+        SampleReduction reduction;
+        float trim;
+        float samples[PROBE_MAX_SAMPLES];
+        uint8_t count;
+    };
+
+    ProbeTimeline timeline_;
+    Channel channels_[PROBE_MAX_CHANNELS];
+    uint32_t cycleStart_ = 0;
+    bool running_ = false;
+    uint32_t cycles_ = 0;
+    uint32_t overruns_ = 0;
+};
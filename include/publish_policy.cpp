@@ -0,0 +1,84 @@
+#include "publish_policy.h"
+#include <cmath>
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+
+void PublishPolicy::set_deadband(float absolute, float relative)
+{
+    this->absolute_ = absolute;
+    this->relative_ = relative < 0 ? 0 : relative;
+}
+
+void PublishPolicy::set_heartbeat(uint32_t interval)
+{
+    this->heartbeat_ = interval;
+}
+
+void PublishPolicy::set_min_interval(uint32_t interval)
+{
+    this->minInterval_ = interval;
+}
+
+bool PublishPolicy::shouldPublish(float value, uint32_t now) const
+{
+    if (!this->published_)
+        return true;
+
+    const uint32_t silent = now - this->lastTime_;
+    if (this->heartbeat_ != 0 && silent >= this->heartbeat_)
+        return true;
+    if (this->minInterval_ != 0 && silent < this->minInterval_)
+        return false;
+    if (this->absolute_ < 0)
+        return true;
+
+    // NaN only ever compares unequal, publish when the value starts or stops being NaN
+    if (std::isnan(value) || std::isnan(this->last_))
+        return std::isnan(value) != std::isnan(this->last_);
+
+    const float band = fmaxf(this->absolute_, this->relative_ * fabsf(this->last_));
+    return fabsf(value - this->last_) > band;
+}
+
+bool PublishPolicy::publish(esphome::sensor::Sensor *sensor, float value)
+{
+    for (auto &callback : this->callbacks_)
+        callback(value);
+
+    const uint32_t now = esphome::millis();
+    if (!this->shouldPublish(value, now))
+    {
+        this->suppressed_++;
+        return false;
+    }
+
+    this->published_ = true;
+    this->last_ = value;
+    this->lastTime_ = now;
+    this->sent_++;
+    sensor->publish_state(value);
+    return true;
+}
+
+std::vector<esphome::sensor::Sensor *> PublishReport::add(const PublishPolicy *policy)
+{
+    Entry entry = {policy, new esphome::sensor::Sensor(), new esphome::sensor::Sensor()};
+    this->entries_.push_back(entry);
+    if (this->entries_.size() == 1)
+        esphome::App.register_component(this);
+    return {entry.sent, entry.suppressed};
+}
+
+float PublishReport::get_setup_priority() const
+{
+    return esphome::setup_priority::LATE;
+}
+
+void PublishReport::update()
+{
+    for (Entry &entry : this->entries_)
+    {
+        entry.sent->publish_state(entry.policy->sent());
+        entry.suppressed->publish_state(entry.policy->suppressed());
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/core/component.h"
+
+// Decides which values of a sensor are worth publishing to the API. With
+// nothing configured every value is published.
+//
+// A value is published when it moved beyond the deadband from the last
+// published value, or when the sensor has been silent for the heartbeat
+// interval. A minimum interval rate limits publishes that the deadband lets
+// through. Decisions are only made when a new value arrives.
+class PublishPolicy
+{
+public:
+    // publish when |value - last| > max(absolute, relative * |last|); a
+    // negative absolute deadband disables the deadband
+    void set_deadband(float absolute, float relative = 0);
+    // publish at least this often (ms) even when the value does not move, 0 disables
+    void set_heartbeat(uint32_t interval);
+    // never publish more often than this (ms), 0 disables; the heartbeat is not limited
+    void set_min_interval(uint32_t interval);
+
+    // publishes value on sensor when the policy allows it, true when it was published
+    bool publish(esphome::sensor::Sensor *sensor, float value);
+
+    // called with every value offered to publish(), before the policy decides,
+    // e.g. to record a history at the full reading rate
+    void add_on_value_callback(std::function<void(float)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+
+    uint32_t sent() const { return this->sent_; }
+    uint32_t suppressed() const { return this->suppressed_; }
+
+protected:
+    bool shouldPublish(float value, uint32_t now) const;
+
+    float absolute_ = -1;
+    float relative_ = 0;
+    uint32_t heartbeat_ = 0;
+    uint32_t minInterval_ = 0;
+
+    bool published_ = false;
+    float last_ = 0;
+    uint32_t lastTime_ = 0;
+    uint32_t sent_ = 0;
+    uint32_t suppressed_ = 0;
+    std::vector<std::function<void(float)>> callbacks_;
+};
+
+// Publishes how many values of each PublishPolicy were sent and suppressed
+// since boot as diagnostic sensors every update interval, so the effect of a
+// deadband or heartbeat can be watched at runtime.
+class PublishReport : public esphome::PollingComponent
+{
+public:
+    explicit PublishReport(uint32_t updateInterval = 300000) : PollingComponent(updateInterval) {}
+
+    // sensors for the sent and suppressed counts of policy
+    std::vector<esphome::sensor::Sensor *> add(const PublishPolicy *policy);
+
+    float get_setup_priority() const override;
+    void update() override;
+
+protected:
+    struct Entry
+    {
+        const PublishPolicy *policy;
+        esphome::sensor::Sensor *sent;
+        esphome::sensor::Sensor *suppressed;
+    };
+    std::vector<Entry> entries_;
+};
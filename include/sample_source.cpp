@@ -0,0 +1,37 @@
+#include "sample_source.h"
+#include <cmath>
+
+SimulatedSampleSource::SimulatedSampleSource(float level, uint32_t sampleRate, uint32_t seed)
+    : level_(level), rate_(sampleRate > 0 ? sampleRate : 1), state_(seed != 0 ? seed : 1)
+{
+}
+
+size_t SimulatedSampleSource::read(float *buffer, size_t count)
+{
+    const double step = 1.0 / this->rate_;
+    const double omega = 2 * M_PI * this->mains_;
+    for (size_t i = 0; i < count; i++)
+    {
+        // in double, t grows for as long as the source runs
+        const double t = this->delivered_++ * step;
+        buffer[i] = this->level_ + (float)(this->drift_ * t) + this->hum_ * (float)sin(omega * t);
+        if (this->noise_ > 0)
+            buffer[i] += this->noise_ * this->gaussian();
+    }
+    return count;
+}
+
+float SimulatedSampleSource::gaussian()
+{
+    // sum of four uniforms (xorshift32), close enough to normal for test signals
+    float sum = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        this->state_ ^= this->state_ << 13;
+        this->state_ ^= this->state_ >> 17;
+        this->state_ ^= this->state_ << 5;
+        sum += (this->state_ >> 8) * (1.0f / 16777216.0f);
+    }
+    // four uniforms have mean 2 and variance 1/3
+    return (sum - 2) * 1.7320508f;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "esphome/components/adc/adc_sensor.h"
+
+// A source of probe voltages that delivers them in blocks. read() writes
+// straight into the caller's buffer, so a driver can size its blocks to the
+// oversampling it wants without an intermediate copy.
+class SampleSource
+{
+public:
+    virtual ~SampleSource() = default;
+
+    // writes up to count voltages into buffer and returns how many were
+    // written; a failed conversion is written as NAN
+    virtual size_t read(float *buffer, size_t count) = 0;
+
+    // samples per second the source delivers, 0 when it converts on demand
+    virtual uint32_t sample_rate() const { return 0; }
+};
+
+// One-shot conversions of an ESPHome ADC sensor, one per sample.
+class AdcSampleSource : public SampleSource
+{
+public:
+    explicit AdcSampleSource(esphome::adc::ADCSensor *adc) : adc_(adc) {}
+
+    size_t read(float *buffer, size_t count) override
+    {
+        for (size_t i = 0; i < count; i++)
+            buffer[i] = this->adc_->sample();
+        return count;
+    }
+
+protected:
+    esphome::adc::ADCSensor *adc_;
+};
+
+// A deterministic synthetic probe signal for host runs and benchmarks:
+//
+//   v(t) = level + drift t + hum sin(2 pi mains t) + gaussian noise
+//
+// t advances by 1 / sample_rate per sample, independent of the wall clock, so
+// the same seed always yields the same samples.
+class SimulatedSampleSource : public SampleSource
+{
+public:
+    explicit SimulatedSampleSource(float level = 1.5, uint32_t sampleRate = 1000, uint32_t seed = 1);
+
+    size_t read(float *buffer, size_t count) override;
+    uint32_t sample_rate() const override { return this->rate_; }
+
+    void set_level(float level) { this->level_ = level; }
+    // standard deviation of the white noise, V
+    void set_noise(float stddev) { this->noise_ = stddev; }
+    // V per second
+    void set_drift(float drift) { this->drift_ = drift; }
+    // amplitude in V and mains frequency in Hz
+    void set_hum(float amplitude, float frequency = 50) { this->hum_ = amplitude, this->mains_ = frequency; }
+
+    // seconds of signal delivered so far
+    double time() const { return (double)this->delivered_ / this->rate_; }
+
+protected:
+    float gaussian();
+
+    float level_;
+    uint32_t rate_;
+    uint32_t state_;
+    float noise_ = 0;
+    float drift_ = 0;
+    float hum_ = 0;
+    float mains_ = 50;
+    uint64_t delivered_ = 0;
+};
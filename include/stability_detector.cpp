@@ -0,0 +1,98 @@
+#include "stability_detector.h"
+#include <cmath>
+
+void StabilityDetector::configure(uint8_t window, uint32_t interval, float max_stddev, float max_drift)
+{
+    this->window_ = window < 2 ? 2 : (window > STABILITY_MAX_WINDOW ? STABILITY_MAX_WINDOW : window);
+    this->interval_ = interval;
+    this->maxStdDev_ = max_stddev;
+    this->maxDrift_ = max_drift;
+    this->reset();
+}
+
+void StabilityDetector::reset()
+{
+    this->head_ = 0;
+    this->count_ = 0;
+    this->reference_ = 0;
+    this->mean_ = 0;
+    this->m2_ = 0;
+    this->weighted_ = 0;
+}
+
+bool StabilityDetector::add(float value)
+{
+    if (this->count_ == 0)
+        this->reference_ = value;
+    const float x = value - this->reference_;
+
+    if (this->count_ == this->window_)
+    {
+        // the oldest sample leaves, it sits at index 0 and adds nothing to weighted_
+        const float old = this->samples_[this->head_];
+        const uint8_t n = this->count_ - 1;
+        const float mean = this->mean_;
+        this->mean_ = (this->count_ * mean - old) / n;
+        this->m2_ -= (old - mean) * (old - this->mean_);
+        this->count_ = n;
+        // every remaining sample moves down one index
+        this->weighted_ -= n * this->mean_;
+    }
+
+    this->samples_[this->head_] = x;
+    this->head_ = (this->head_ + 1) % this->window_;
+    this->weighted_ += this->count_ * x;
+    this->count_++;
+    const float delta = x - this->mean_;
+    this->mean_ += delta / this->count_;
+    this->m2_ += delta * (x - this->mean_);
+
+    if (this->head_ == 0)
+        this->recompute();
+
+    return this->stable();
+}
+
+void StabilityDetector::recompute()
+{
+    // head_ is 0, so the window starts at samples_[0]
+    float sum = 0;
+    float weighted = 0;
+    for (uint8_t i = 0; i < this->count_; i++)
+    {
+        sum += this->samples_[i];
+        weighted += i * this->samples_[i];
+    }
+    const float mean = sum / this->count_;
+    float m2 = 0;
+    for (uint8_t i = 0; i < this->count_; i++)
+        m2 += (this->samples_[i] - mean) * (this->samples_[i] - mean);
+
+    this->mean_ = mean;
+    this->m2_ = m2;
+    this->weighted_ = weighted;
+}
+
+bool StabilityDetector::stable() const
+{
+    return this->count_ == this->window_ && this->stddev() <= this->maxStdDev_ &&
+           fabsf(this->drift()) <= this->maxDrift_;
+}
+
+float StabilityDetector::stddev() const
+{
+    if (this->count_ < 2 || this->m2_ <= 0)
+        return 0;
+    return sqrtf(this->m2_ / (this->count_ - 1));
+}
+
+float StabilityDetector::drift() const
+{
+    const uint8_t n = this->count_;
+    if (n < 2 || this->interval_ == 0)
+        return 0;
+    // slope = sum (i - mean i) x / sum (i - mean i)^2, per sample
+    const float centered = this->weighted_ - (n - 1) * 0.5f * n * this->mean_;
+    const float spread = n * ((float)n * n - 1) / 12;
+    return centered / spread * 1000 / this->interval_;
+}
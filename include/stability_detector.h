@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// upper bound on the samples in the window, they are kept inline
+#define STABILITY_MAX_WINDOW 64
+
+// Decides when a settling signal, such as a probe that was just put into a
+// buffer solution, has become stable.
+//
+// The detector keeps the last `window` samples, taken every `interval` ms,
+// and updates their mean and variance with Welford's algorithm as samples
+// enter and leave the window, together with the least-squares slope (drift)
+// of the window. The signal is stable once the window is full and both the
+// standard deviation and the drift are within their limits. Every update is
+// O(1); the sums are recomputed exactly once per window to shed rounding.
+class StabilityDetector
+{
+public:
+    // window samples (2..STABILITY_MAX_WINDOW) every interval ms; stable when
+    // stddev <= max_stddev and |drift| <= max_drift, in units per second
+    void configure(uint8_t window, uint32_t interval, float max_stddev, float max_drift);
+
+    // forgets all samples
+    void reset();
+
+    // adds the next sample, true when the signal is stable
+    bool add(float value);
+
+    bool stable() const;
+
+    uint8_t count() const { return this->count_; }
+    uint8_t window() const { return this->window_; }
+    uint32_t interval() const { return this->interval_; }
+
+    float mean() const { return this->reference_ + this->mean_; }
+    float stddev() const;
+    // slope of the window in units per second
+    float drift() const;
+
+protected:
+    void recompute();
+
+    float samples_[STABILITY_MAX_WINDOW];
+    uint8_t window_ = 20;
+    uint8_t head_ = 0;
+    uint8_t count_ = 0;
+    uint32_t interval_ = 250;
+    float maxStdDev_ = 0;
+    float maxDrift_ = 0;
+
+    // samples are kept relative to the first one after reset(), which keeps
+    // the sums small enough for float
+    float reference_ = 0;
+    float mean_ = 0;
+    float m2_ = 0;
+    // sum of i * x over the window, i = 0 for the oldest sample
+    float weighted_ = 0;
+};
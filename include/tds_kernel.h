@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+
+#define TdsFactor 0.5 // tds = ec / 2
+
+// DFRobot Gravity TDS conversion EC = 133.42 v^3 - 255.86 v^2 + 857.39 v, in
+// Horner form with float literals. The ESP32 has a single precision FPU only,
+// every double literal would pull the whole expression into software double
+// emulation.
+constexpr float TDS_EC_C3 = 133.42f;
+constexpr float TDS_EC_C2 = -255.86f;
+constexpr float TDS_EC_C1 = 857.39f;
+constexpr float TDS_TEMPERATURE_COEFFICIENT = 0.02f;
+constexpr float TDS_REFERENCE_TEMPERATURE = 25.0f;
+
+// uncompensated EC for a probe voltage
+constexpr float tdsRawEc(float v)
+{
+    return v * (TDS_EC_C1 + v * (TDS_EC_C2 + v * TDS_EC_C3));
+}
+
+// dEC/dv of tdsRawEc, how much EC moves per volt at v
+constexpr float tdsRawEcSlope(float v)
+{
+    return TDS_EC_C1 + v * (2 * TDS_EC_C2 + v * 3 * TDS_EC_C3);
+}
+
+// factor EC is divided by to refer it to 25 C
+constexpr float tdsTemperatureCompensation(float celsius)
+{
+    return 1.0f + TDS_TEMPERATURE_COEFFICIENT * (celsius - TDS_REFERENCE_TEMPERATURE);
+}
+
+// TDS (ppm) per unit of raw EC: the cell constant, the temperature
+// compensation and the EC to TDS factor folded together. Every TDS
+// conversion goes through this, tds = tdsScale(k, T) * tdsRawEc(v).
+constexpr float tdsScale(float kValue, float celsius)
+{
+    return kValue * (float)TdsFactor / tdsTemperatureCompensation(celsius);
+}
+
+// Q16.16 fixed point, for targets without any FPU
+typedef int32_t q16_16;
+
+constexpr q16_16 toQ16(float x)
+{
+    return (q16_16)(x * 65536.0f + (x < 0 ? -0.5f : 0.5f));
+}
+
+constexpr float fromQ16(q16_16 x)
+{
+    return x / 65536.0f;
+}
+
+constexpr q16_16 mulQ16(q16_16 a, q16_16 b)
+{
+    return (q16_16)(((int64_t)a * b) >> 16);
+}
+
+constexpr q16_16 TDS_EC_C3_Q16 = toQ16(TDS_EC_C3);
+constexpr q16_16 TDS_EC_C2_Q16 = toQ16(TDS_EC_C2);
+constexpr q16_16 TDS_EC_C1_Q16 = toQ16(TDS_EC_C1);
+
+// tdsRawEc in Q16.16, valid for 0 <= v <= 3.6 V where EC stays below 2^15
+constexpr q16_16 tdsRawEcQ16(q16_16 v)
+{
+    return mulQ16(v, TDS_EC_C1_Q16 + mulQ16(v, TDS_EC_C2_Q16 + mulQ16(v, TDS_EC_C3_Q16)));
+}
+
+// Voltage to TDS (ppm) with the cell constant, the temperature compensation and
+// the EC to TDS factor folded into one scale. The scale only changes with the
+// temperature or the calibration, so a conversion is the cubic and one multiply.
+class TdsKernel
+{
+public:
+    void setCompensation(float kValue, float celsius)
+    {
+        this->scale_ = tdsScale(kValue, celsius);
+        this->scaleQ16_ = toQ16(this->scale_);
+    }
+
+    float convert(float v) const { return this->scale_ * tdsRawEc(v); }
+
+    // the same conversion in Q16.16, v and the result are Q16.16 as well
+    q16_16 convertQ16(q16_16 v) const { return mulQ16(this->scaleQ16_, tdsRawEcQ16(v)); }
+
+    float scale() const { return this->scale_; }
+
+protected:
+    float scale_ = (float)TdsFactor;
+    q16_16 scaleQ16_ = toQ16((float)TdsFactor);
+};
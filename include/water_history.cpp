@@ -0,0 +1,121 @@
+#include "water_history.h"
+#include <cstdio>
+#include <string>
+
+static const char *const TAG = "water_history";
+
+WaterHistoryStore *WaterHistory::addStore(const char *name, float min, float max)
+{
+    if (this->count_ >= HISTORY_MAX_SERIES)
+    {
+        esphome::ESP_LOGE(TAG, "no room for series %s, at most %u are kept", name, HISTORY_MAX_SERIES);
+        return nullptr;
+    }
+
+    const uint8_t index = this->count_++;
+    this->names_[index] = name;
+    this->stores_[index] = new WaterHistoryStore(min, max);
+    return this->stores_[index];
+}
+
+void WaterHistory::add_series(const char *name, PublishPolicy *policy, float min, float max)
+{
+    WaterHistoryStore *store = this->addStore(name, min, max);
+    if (store != nullptr)
+        policy->add_on_value_callback([this, store](float value)
+                                      { store->insert(this->now(), value); });
+}
+
+void WaterHistory::add_series(const char *name, esphome::sensor::Sensor *sensor, float min, float max)
+{
+    WaterHistoryStore *store = this->addStore(name, min, max);
+    if (store != nullptr)
+        sensor->add_on_state_callback([this, store](float value)
+                                      { store->insert(this->now(), value); });
+}
+
+float WaterHistory::get_setup_priority() const
+{
+    return esphome::setup_priority::DATA;
+}
+
+void WaterHistory::setup()
+{
+    register_service(&WaterHistory::on_get_history, "get_history", {"series", "tier", "since"});
+}
+
+uint32_t WaterHistory::now()
+{
+    const uint32_t ms = esphome::millis();
+    this->uptimeMs_ += (uint32_t)(ms - this->lastMillis_);
+    this->lastMillis_ = ms;
+    return (uint32_t)(this->uptimeMs_ / 1000);
+}
+
+void WaterHistory::on_get_history(int series, int tier, int since)
+{
+    if (series < 0 || series >= this->count_ || tier < 0 || tier >= HISTORY_TIERS)
+    {
+        esphome::ESP_LOGW(TAG, "no history for series %d tier %d", series, tier);
+        return;
+    }
+
+    const WaterHistoryStore &store = *this->stores_[series];
+    const HistoryTier historyTier = (HistoryTier)tier;
+    const uint32_t now = this->now();
+    const uint32_t from = since <= 0 || (uint32_t)since > now ? 0 : now - since;
+
+    uint16_t total = 0;
+    store.read(historyTier, from, now, [&total](uint32_t, float, float, float)
+               { total++; });
+    const uint16_t parts = total == 0 ? 1 : (total + HISTORY_RECORDS_PER_EVENT - 1) / HISTORY_RECORDS_PER_EVENT;
+
+    const HistoryQuantizer &q = store.quantizer();
+    char number[48];
+    std::string records;
+    records.reserve(HISTORY_RECORDS_PER_EVENT * (historyTier == HistoryTier::RAW ? 12 : 24));
+    uint16_t part = 0, inPart = 0;
+    uint32_t first = 0, previous = 0;
+
+    auto fire = [&]()
+    {
+        snprintf(number, sizeof(number), "%g", q.offset());
+        std::string offset(number);
+        snprintf(number, sizeof(number), "%g", q.scale());
+        std::string scale(number);
+        this->fire_homeassistant_event("esphome.water_history", {
+                                                                    {"series", this->names_[series]},
+                                                                    {"tier", std::to_string(tier)},
+                                                                    {"offset", offset},
+                                                                    {"scale", scale},
+                                                                    {"age", std::to_string(now - first)},
+                                                                    {"part", std::to_string(part + 1)},
+                                                                    {"parts", std::to_string(parts)},
+                                                                    {"records", records},
+                                                                });
+        part++;
+        inPart = 0;
+        records.clear();
+    };
+
+    store.read(historyTier, from, now, [&](uint32_t time, float min, float max, float avg)
+               {
+        if (inPart == 0)
+            first = previous = time;
+        if (historyTier == HistoryTier::RAW)
+            snprintf(number, sizeof(number), "%u,%u;", (unsigned)(time - previous), q.quantize(avg));
+        else
+            snprintf(number, sizeof(number), "%u,%u,%u,%u;", (unsigned)(time - previous), q.quantize(avg), q.quantize(min), q.quantize(max));
+        records += number;
+        previous = time;
+        if (++inPart == HISTORY_RECORDS_PER_EVENT)
+            fire(); });
+
+    if (inPart > 0 || total == 0)
+    {
+        if (total == 0)
+            first = now;
+        fire();
+    }
+    esphome::ESP_LOGD(TAG, "sent %u records of %s in %u events", total, this->names_[series], parts);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/api/custom_api_device.h"
+#include "esphome/core/component.h"
+#include "esphome/core/application.h"
+#include "history_store.h"
+#include "publish_policy.h"
+
+#define HISTORY_MAX_SERIES 3
+// records per fired event, larger ranges are split into several events
+#define HISTORY_RECORDS_PER_EVENT 120
+
+// Keeps an on-device history of up to HISTORY_MAX_SERIES sensors so readings
+// survive Wi-Fi outages, and serves ranges of it in batched Home Assistant
+// events through the get_history API service. The store of a series (9.6 kB)
+// is allocated by add_series, only the series in use take memory.
+//
+// get_history(series, tier, since) fires esphome.water_history events with
+// the records of the last `since` seconds:
+//   series, tier     - series name and HistoryTier number
+//   offset, scale    - value = offset + q * scale, q = 65535 is a missing value
+//   age              - seconds from the first record of the event until now
+//   part, parts      - position of this event in the response
+//   records          - "dt,avg;" per raw record or "dt,avg,min,max;" per
+//                      rollup, dt in seconds since the previous record
+class WaterHistory : public esphome::Component, public esphome::api::CustomAPIDevice
+{
+public:
+    // records every reading offered to policy, including those its deadband
+    // suppresses, so the rollups are weighted by time; values outside
+    // [min, max] are clamped
+    void add_series(const char *name, PublishPolicy *policy, float min, float max);
+    // records every published state of sensor; behind a deadband or heartbeat
+    // only the changes are recorded, prefer the PublishPolicy overload there
+    void add_series(const char *name, esphome::sensor::Sensor *sensor, float min, float max);
+
+    float get_setup_priority() const override;
+    void setup() override;
+
+    void on_get_history(int series, int tier, int since);
+
+    // uptime in seconds, survives the millis() wrap after 49 days
+    uint32_t now();
+
+    const WaterHistoryStore *store(int series) const
+    {
+        return series >= 0 && series < this->count_ ? this->stores_[series] : nullptr;
+    }
+
+protected:
+    WaterHistoryStore *stores_[HISTORY_MAX_SERIES] = {nullptr};
+    const char *names_[HISTORY_MAX_SERIES] = {nullptr};
+    uint8_t count_ = 0;
+
+    // a store for the next series, nullptr when all are taken
+    WaterHistoryStore *addStore(const char *name, float min, float max);
+
+    uint64_t uptimeMs_ = 0;
+    uint32_t lastMillis_ = 0;
+};
@@ -0,0 +1,89 @@
+#include "water_quality.h"
+#include <cmath>
+#include <string>
+
+static const char *const TAG = "water_quality";
+
+void computeWaterQuality(const WaterQualityFrames &frames, const WaterQualityCalibration &calibration)
+{
+    const size_t n = frames.count;
+
+    if (calibration.ph != nullptr && frames.phVoltage != nullptr && frames.ph != nullptr)
+        calibration.ph->evaluate(frames.phVoltage, frames.ph, n);
+
+    if (frames.tdsVoltage != nullptr && frames.temperature != nullptr && frames.tds != nullptr)
+    {
+        for (size_t i = 0; i < n; i++)
+            frames.tds[i] = tdsScale(calibration.tdsK, frames.temperature[i]) * tdsRawEc(frames.tdsVoltage[i]);
+    }
+
+    if (calibration.tss != nullptr && frames.tssVoltage != nullptr && frames.tss != nullptr)
+        calibration.tss->evaluate(frames.tssVoltage, frames.tss, n);
+}
+
+WaterQualityFrame::WaterQualityFrame(uint32_t updateInterval) : PollingComponent(updateInterval)
+{
+}
+
+float WaterQualityFrame::get_setup_priority() const
+{
+    // after the probe components, whose calibrations are read
+    return esphome::setup_priority::DATA - 1;
+}
+
+void WaterQualityFrame::dump_config()
+{
+    esphome::ESP_LOGCONFIG(TAG, "Water quality frame:");
+    esphome::ESP_LOGCONFIG(TAG, "  pH: %s, TDS: %s, TSS: %s", this->ph_ ? "yes" : "no", this->tds_ ? "yes" : "no",
+                           this->tss_ ? "yes" : "no");
+}
+
+void WaterQualityFrame::update()
+{
+    // acquire everything back to back, then compute and publish
+    const uint32_t now = esphome::millis();
+    const float phV = this->ph_ != nullptr ? this->ph_->read_voltage() : NAN;
+    const float tdsV = this->tds_ != nullptr ? this->tds_->read_voltage() : NAN;
+    const float tssV = this->tss_ != nullptr ? this->tss_->read_voltage() : NAN;
+    const float celsius = this->tds_ != nullptr ? this->tds_->temperature_celsius() : NAN;
+
+    this->batch_.clear();
+    this->batch_.add(now, phV, tdsV, tssV, celsius);
+    WaterQualityFrames frames = this->batch_.frames();
+    if (this->ph_ == nullptr)
+        frames.phVoltage = nullptr;
+    if (this->tds_ == nullptr)
+        frames.tdsVoltage = nullptr;
+    if (this->tss_ == nullptr)
+        frames.tssVoltage = nullptr;
+
+    const WaterQualityCalibration calibration = {
+        this->ph_ != nullptr ? &this->ph_->calibration_curve() : nullptr,
+        this->tds_ != nullptr ? this->tds_->k_value() : 0,
+        this->tss_ != nullptr ? &this->tss_->calibration_curve() : nullptr,
+    };
+    computeWaterQuality(frames, calibration);
+
+    const float ph = this->batch_.ph[0], tds = this->batch_.tds[0], tss = this->batch_.tss[0];
+    if (this->ph_ != nullptr)
+        this->ph_->publish_reading(phV, ph);
+    if (this->tds_ != nullptr)
+        this->tds_->publish_reading(tdsV, tds, celsius);
+    if (this->tss_ != nullptr)
+        this->tss_->publish_reading(tssV, tss);
+
+    if (this->frameEvent_)
+    {
+        std::map<std::string, std::string> data = {{"time", std::to_string(now)}};
+        if (this->ph_ != nullptr)
+            data["ph"] = std::to_string(ph);
+        if (this->tds_ != nullptr)
+        {
+            data["tds"] = std::to_string(tds);
+            data["temperature"] = std::to_string(celsius);
+        }
+        if (this->tss_ != nullptr)
+            data["tss"] = std::to_string(tss);
+        this->fire_homeassistant_event("esphome.water_quality", data);
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/adc/adc_sensor.h"
+#include "esphome/components/api/custom_api_device.h"
+#include "esphome/core/component.h"
+#include "esphome/core/application.h"
+#include "calibration_curve.h"
+#include "gravity_ph.h"
+#include "gravity_tds.h"
+#include "gravity_tss.h"
+#include "polynomial_calibration.h"
+#include "tds_kernel.h"
+
+// Struct-of-arrays view of `count` time aligned frames: input i of every
+// array belongs to the same instant. Compute loops run over one array at a
+// time, so they stay on contiguous floats no matter how many frames are
+// batched. A null array leaves that parameter out.
+struct WaterQualityFrames
+{
+    size_t count;
+    const float *phVoltage;
+    const float *tdsVoltage;
+    const float *tssVoltage;
+    // C, compensates TDS
+    const float *temperature;
+    float *ph;
+    float *tds;
+    float *tss;
+};
+
+// storage for up to N frames
+template <size_t N>
+struct WaterQualityBatch
+{
+    uint32_t time[N];
+    float phVoltage[N];
+    float tdsVoltage[N];
+    float tssVoltage[N];
+    float temperature[N];
+    float ph[N];
+    float tds[N];
+    float tss[N];
+    size_t count = 0;
+
+    // false when the batch is full
+    bool add(uint32_t t, float phV, float tdsV, float tssV, float celsius)
+    {
+        if (this->count >= N)
+            return false;
+        const size_t i = this->count++;
+        this->time[i] = t;
+        this->phVoltage[i] = phV;
+        this->tdsVoltage[i] = tdsV;
+        this->tssVoltage[i] = tssV;
+        this->temperature[i] = celsius;
+        return true;
+    }
+
+    void clear() { this->count = 0; }
+
+    WaterQualityFrames frames()
+    {
+        return {this->count, this->phVoltage, this->tdsVoltage, this->tssVoltage, this->temperature,
+                this->ph, this->tds, this->tss};
+    }
+};
+
+// The calibrations a batch is computed with; a null calibration leaves the
+// parameter out.
+struct WaterQualityCalibration
+{
+    const CalibrationCurve *ph;
+    // TDS cell constant
+    float tdsK;
+    const PolynomialCalibration *tss;
+};
+
+// Computes pH, TDS and TSS of every frame in one pass per parameter, each
+// against one consistent calibration.
+void computeWaterQuality(const WaterQualityFrames &frames, const WaterQualityCalibration &calibration);
+
+// Takes one time aligned frame per update: the pH, TDS and TSS voltages back
+// to back and one temperature, computes all parameters together and publishes
+// them in the same pass. Every parameter is published through its component,
+// with its calibration and publish policy, and the components skip their own
+// poll while frames arrive; give them a long update interval.
+class WaterQualityFrame : public esphome::PollingComponent, public esphome::api::CustomAPIDevice
+{
+public:
+    explicit WaterQualityFrame(uint32_t updateInterval = 15000);
+
+    void set_ph(GravityPhSensor *ph) { this->ph_ = ph; }
+    void set_tds(GravityTdsSensor *tds) { this->tds_ = tds; }
+    void set_tss(GravityTssSensor *tss) { this->tss_ = tss; }
+    // also fire every frame as an esphome.water_quality event with its time
+    void set_frame_event(bool enabled) { this->frameEvent_ = enabled; }
+
+    float get_setup_priority() const override;
+    void dump_config() override;
+    void update() override;
+
+protected:
+    GravityPhSensor *ph_ = nullptr;
+    GravityTdsSensor *tds_ = nullptr;
+    GravityTssSensor *tss_ = nullptr;
+    bool frameEvent_ = false;
+    WaterQualityBatch<1> batch_;
+};